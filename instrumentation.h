@@ -0,0 +1,288 @@
+// Счётчики и гистограммы для горячих путей массивов (pz6, pz9, main).
+//
+// Включается при компиляции: -DARRAY_INSTRUMENTATION. Без этого макросы
+// INSTR_COUNT / INSTR_RECORD / INSTR_SCOPE_TIMER раскрываются в пустоту и
+// ничего не стоят.
+//
+// Каждый поток пишет в свои счётчики (без блокировок и общих кэш-линий);
+// Instrumentation::snapshot() складывает живые потоки и уже завершившиеся
+// и выдаёт снимок в виде текста или JSON.
+#pragma once
+
+#ifdef ARRAY_INSTRUMENTATION
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class Instrumentation {
+public:
+    static constexpr int kMaxCounters = 64;
+    static constexpr int kMaxHistograms = 16;
+    static constexpr int kBuckets = 65;  // корзина b: значения [2^(b-1), 2^b)
+
+    // Гистограмма в снимке: корзины по степеням двойки
+    struct Histogram {
+        std::string name;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(kBuckets, 0);
+
+        // Верхняя граница корзины, в которую попадает доля q значений
+        uint64_t quantileBound(double q) const {
+            uint64_t rank = static_cast<uint64_t>(q * count);
+            uint64_t seen = 0;
+            for (int b = 0; b < kBuckets; b++) {
+                seen += buckets[b];
+                if (seen > rank)
+                    return bucketLimit(b);
+            }
+            return 0;
+        }
+    };
+
+    struct Snapshot {
+        std::vector<std::pair<std::string, uint64_t>> counters;
+        std::vector<Histogram> histograms;
+
+        std::string toText() const {
+            std::ostringstream out;
+            out << "Инструментирование:\n";
+            for (const auto& c : counters)
+                out << "  " << c.first << " = " << c.second << "\n";
+            for (const auto& h : histograms) {
+                out << "  " << h.name << ": n = " << h.count;
+                if (h.count > 0) {
+                    out << ", среднее = " << h.sum / h.count
+                        << ", p50 <= " << h.quantileBound(0.5)
+                        << ", p99 <= " << h.quantileBound(0.99);
+                }
+                out << "\n";
+            }
+            return out.str();
+        }
+
+        std::string toJson() const {
+            std::ostringstream out;
+            out << "{\"counters\":{";
+            for (size_t i = 0; i < counters.size(); i++)
+                out << (i ? "," : "") << "\"" << counters[i].first << "\":" << counters[i].second;
+            out << "},\"histograms\":{";
+            for (size_t i = 0; i < histograms.size(); i++) {
+                const Histogram& h = histograms[i];
+                out << (i ? "," : "") << "\"" << h.name << "\":{\"count\":" << h.count
+                    << ",\"sum\":" << h.sum << ",\"buckets\":[";
+                for (int b = 0; b < kBuckets; b++)
+                    out << (b ? "," : "") << h.buckets[b];
+                out << "]}";
+            }
+            out << "}}";
+            return out.str();
+        }
+    };
+
+    // Номер счётчика/гистограммы по имени; одно имя - один номер
+    static int counterId(const char* name) {
+        return registerName(registry().counterNames, name, kMaxCounters);
+    }
+
+    static int histogramId(const char* name) {
+        return registerName(registry().histogramNames, name, kMaxHistograms);
+    }
+
+    // Горячий путь: только свои атомики потока, relaxed load + store
+    static void add(int id, uint64_t delta) {
+        bump(local().counters[id], delta);
+    }
+
+    static void record(int id, uint64_t value) {
+        Slots::Hist& h = local().histograms[id];
+        bump(h.count, 1);
+        bump(h.sum, value);
+        bump(h.buckets[bucketOf(value)], 1);
+    }
+
+    static Snapshot snapshot() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        Totals totals = r.retired;
+        for (const Slots* s : r.live)
+            totals.add(*s);
+
+        Snapshot snap;
+        for (size_t i = 0; i < r.counterNames.size(); i++)
+            snap.counters.emplace_back(r.counterNames[i], totals.counters[i]);
+        for (size_t i = 0; i < r.histogramNames.size(); i++) {
+            Histogram h;
+            h.name = r.histogramNames[i];
+            h.count = totals.histograms[i].count;
+            h.sum = totals.histograms[i].sum;
+            for (int b = 0; b < kBuckets; b++)
+                h.buckets[b] = totals.histograms[i].buckets[b];
+            snap.histograms.push_back(h);
+        }
+        return snap;
+    }
+
+    // Замер времени области в наносекундах
+    class ScopeTimer {
+    public:
+        explicit ScopeTimer(int id) : id(id), start(std::chrono::steady_clock::now()) {}
+
+        ~ScopeTimer() {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            record(id, static_cast<uint64_t>(ns));
+        }
+
+        ScopeTimer(const ScopeTimer&) = delete;
+        ScopeTimer& operator=(const ScopeTimer&) = delete;
+
+    private:
+        int id;
+        std::chrono::steady_clock::time_point start;
+    };
+
+private:
+    using Cell = std::atomic<uint64_t>;
+
+    // Счётчики одного потока. Пишет только владелец, snapshot() читает
+    struct alignas(64) Slots {
+        struct Hist {
+            Cell count{0};
+            Cell sum{0};
+            Cell buckets[kBuckets] = {};
+        };
+        Cell counters[kMaxCounters] = {};
+        Hist histograms[kMaxHistograms];
+    };
+
+    // Сумма по потокам (обычные числа, под мьютексом реестра)
+    struct Totals {
+        struct Hist {
+            uint64_t count = 0;
+            uint64_t sum = 0;
+            uint64_t buckets[kBuckets] = {};
+        };
+        uint64_t counters[kMaxCounters] = {};
+        Hist histograms[kMaxHistograms];
+
+        void add(const Slots& s) {
+            for (int i = 0; i < kMaxCounters; i++)
+                counters[i] += s.counters[i].load(std::memory_order_relaxed);
+            for (int i = 0; i < kMaxHistograms; i++) {
+                histograms[i].count += s.histograms[i].count.load(std::memory_order_relaxed);
+                histograms[i].sum += s.histograms[i].sum.load(std::memory_order_relaxed);
+                for (int b = 0; b < kBuckets; b++)
+                    histograms[i].buckets[b] += s.histograms[i].buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::string> counterNames;
+        std::vector<std::string> histogramNames;
+        std::vector<const Slots*> live;
+        Totals retired;  // счётчики завершившихся потоков
+    };
+
+    // Регистрирует Slots потока в реестре; при выходе потока его
+    // значения переносятся в retired
+    struct LocalSlots {
+        Slots slots;
+
+        LocalSlots() {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.live.push_back(&slots);
+        }
+
+        ~LocalSlots() {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.retired.add(slots);
+            for (size_t i = 0; i < r.live.size(); i++) {
+                if (r.live[i] == &slots) {
+                    r.live[i] = r.live.back();
+                    r.live.pop_back();
+                    break;
+                }
+            }
+        }
+    };
+
+    static Registry& registry() {
+        static Registry* r = new Registry();  // живёт дольше потоков при выходе
+        return *r;
+    }
+
+    static Slots& local() {
+        thread_local LocalSlots l;
+        return l.slots;
+    }
+
+    static void bump(Cell& cell, uint64_t delta) {
+        cell.store(cell.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    static int bucketOf(uint64_t value) {
+        int b = 0;
+        while (value) {
+            value >>= 1;
+            b++;
+        }
+        return b;
+    }
+
+    static uint64_t bucketLimit(int b) {
+        return b >= 64 ? UINT64_MAX : (uint64_t(1) << b) - 1;
+    }
+
+    static int registerName(std::vector<std::string>& names, const char* name, int limit) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (size_t i = 0; i < names.size(); i++)
+            if (names[i] == name)
+                return static_cast<int>(i);
+        if (static_cast<int>(names.size()) >= limit)
+            throw std::length_error(std::string("Слишком много точек инструментирования: ") + name);
+        names.push_back(name);
+        return static_cast<int>(names.size() - 1);
+    }
+};
+
+#define INSTR_CONCAT_(a, b) a##b
+#define INSTR_CONCAT(a, b) INSTR_CONCAT_(a, b)
+
+// Увеличить счётчик name (строковый литерал) на 1
+#define INSTR_COUNT(name) \
+    do { \
+        static const int instrId = Instrumentation::counterId(name); \
+        Instrumentation::add(instrId, 1); \
+    } while (0)
+
+// Добавить value в гистограмму name
+#define INSTR_RECORD(name, value) \
+    do { \
+        static const int instrId = Instrumentation::histogramId(name); \
+        Instrumentation::record(instrId, static_cast<uint64_t>(value)); \
+    } while (0)
+
+// Время до конца текущей области (нс) - в гистограмму name
+#define INSTR_SCOPE_TIMER(name) \
+    static const int INSTR_CONCAT(instrTimerId, __LINE__) = Instrumentation::histogramId(name); \
+    Instrumentation::ScopeTimer INSTR_CONCAT(instrTimer, __LINE__)(INSTR_CONCAT(instrTimerId, __LINE__))
+
+#else
+
+#define INSTR_COUNT(name) ((void)0)
+#define INSTR_RECORD(name, value) ((void)0)
+#define INSTR_SCOPE_TIMER(name) ((void)0)
+
+#endif
@@ -4,46 +4,1048 @@
 #include <ctime>
 #include <iomanip>
 #include <sstream>
+#include <charconv>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <filesystem>
+#include <chrono>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DYNARRAY_HAS_MMAP 1
+#else
+#include <iterator>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DYNARRAY_HAS_X86_SIMD 1
+#endif
+
+#include "instrumentation.h"
+#include "parallel.h"
+
+// Результат сохранения: куда, сколько байт и элементов записано.
+// Если сохранение разбито на сегменты, file - первый из них, а segments -
+// все файлы по порядку элементов.
+struct SaveStats {
+    std::string file;
+    size_t bytes = 0;
+    size_t elements = 0;
+    std::vector<std::string> segments;
+};
+
+// Буфер форматирования для save(): числа переводятся в текст через
+// std::to_chars в большой буфер потока, который сбрасывается в файл
+// крупными блоками. Буфер выделяется один раз на поток и переиспользуется.
+class FormatBuffer {
+public:
+    static constexpr size_t kCapacity = 1 << 20;
+    static constexpr size_t kMaxIntChars = 11;  // "-2147483648"
+
+    explicit FormatBuffer(std::ostream& out)
+        : out(out), buf(threadBuffer()), used(0), written(0) {}
+
+    ~FormatBuffer() {
+        flush();
+    }
+
+    void putInt(int value) {
+        if (used + kMaxIntChars > kCapacity)
+            flush();
+        char* begin = buf.data();
+        used = std::to_chars(begin + used, begin + kCapacity, value).ptr - begin;
+    }
+
+    void putChar(char c) {
+        if (used == kCapacity)
+            flush();
+        buf[used++] = c;
+    }
+
+    void flush() {
+        if (used > 0) {
+            out.write(buf.data(), used);
+            written += used;
+            used = 0;
+        }
+    }
+
+    // Сколько байт отдано в поток (включая ещё не сброшенные)
+    size_t bytes() const { return written + used; }
+
+private:
+    static std::vector<char>& threadBuffer() {
+        thread_local std::vector<char> storage(kCapacity);
+        return storage;
+    }
+
+    std::ostream& out;
+    std::vector<char>& buf;
+    size_t used;
+    size_t written;
+};
+
+// Файл, отображённый в память. По умолчанию только для чтения; writable -
+// существующий файл открывается для записи (новый не создаётся), запись в
+// mutableData() попадает в файл, а resize меняет его длину.
+// Без mmap (не POSIX) содержимое просто читается в память целиком, а
+// writable-файл записывается обратно в sync() и при уничтожении.
+class MappedFile {
+public:
+    // Подсказка ядру о порядке обращений (madvise): Sequential - читать
+    // вперёд и быстрее отпускать пройденное, Random - не читать лишнего
+    enum class Advice { Normal, Sequential, Random };
+
+    explicit MappedFile(const std::string& filename, bool writable = false)
+        : filename(filename), writable(writable) {
+#ifdef DYNARRAY_HAS_MMAP
+        fd = writable ? ::open(filename.c_str(), O_RDWR)
+                      : ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Не удалось открыть файл " + filename);
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Не удалось получить размер файла " + filename);
+        }
+        length = static_cast<size_t>(st.st_size);
+
+        if (length > 0) {
+            try {
+                map();
+            } catch (...) {
+                ::close(fd);
+                throw;
+            }
+        }
+        // Для чтения дескриптор не нужен: отображение держит файл само
+        if (!writable) {
+            ::close(fd);
+            fd = -1;
+        }
+#else
+        std::ifstream in(filename, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Не удалось открыть файл " + filename);
+        copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        bytes = copy.data();
+        length = copy.size();
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef DYNARRAY_HAS_MMAP
+        if (bytes)
+            ::munmap(bytes, length);
+        if (fd >= 0)
+            ::close(fd);
+#else
+        if (writable) {
+            try {
+                sync();
+            } catch (...) {
+            }
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+    char* mutableData() {
+        if (!writable)
+            throw std::logic_error("Файл " + filename + " открыт только для чтения");
+        return bytes;
+    }
+
+    // Новая длина файла (writable). Отображение может переместиться:
+    // указатели из data() после этого недействительны. Новые байты - нули
+    // и места на диске не занимают, пока в них не пишут.
+    void resize(size_t newLength) {
+        if (!writable)
+            throw std::logic_error("Файл " + filename + " открыт только для чтения");
+        if (newLength == length)
+            return;
+#ifdef DYNARRAY_HAS_MMAP
+        if (::ftruncate(fd, static_cast<off_t>(newLength)) != 0)
+            throw std::runtime_error("Не удалось изменить размер файла " + filename);
+        if (bytes && newLength > 0) {
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+            void* p = ::mremap(bytes, length, newLength, MREMAP_MAYMOVE);
+            if (p == MAP_FAILED)
+                throw std::runtime_error("Не удалось отобразить файл " + filename);
+            bytes = static_cast<char*>(p);
+            length = newLength;
+            return;
+#endif
+        }
+        if (bytes) {
+            ::munmap(bytes, length);
+            bytes = nullptr;
+        }
+        length = newLength;
+        if (length > 0)
+            map();
+        advise(advice);
+#else
+        copy.resize(newLength);
+        bytes = copy.data();
+        length = newLength;
+#endif
+    }
+
+    void advise(Advice hint) {
+        advice = hint;
+#ifdef DYNARRAY_HAS_MMAP
+        if (bytes) {
+            int flag = hint == Advice::Sequential ? MADV_SEQUENTIAL
+                     : hint == Advice::Random ? MADV_RANDOM : MADV_NORMAL;
+            ::madvise(bytes, length, flag);
+        }
+#endif
+    }
+
+    // Убрать страницы [offset, offset + count) из памяти процесса: данные
+    // остаются в файле (изменённые - в страничном кэше до записи на диск)
+    // и подгрузятся снова при обращении. Так проход по большому файлу
+    // не копит резидентную память.
+    void evict(size_t offset, size_t count) {
+#ifdef DYNARRAY_HAS_MMAP
+        static const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        size_t end = std::min(length, offset + count);
+        size_t first = offset / page * page;
+        if (bytes && first < end)
+            ::madvise(bytes + first, end - first, MADV_DONTNEED);
+#else
+        (void)offset;
+        (void)count;
+#endif
+    }
+
+    // Дождаться записи изменённых страниц на диск (writable)
+    void sync() {
+        if (!writable)
+            return;
+#ifdef DYNARRAY_HAS_MMAP
+        if (bytes && ::msync(bytes, length, MS_SYNC) != 0)
+            throw std::runtime_error("Не удалось записать файл " + filename);
+#else
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        out.write(copy.data(), static_cast<std::streamsize>(copy.size()));
+        if (!out.flush())
+            throw std::runtime_error("Не удалось записать файл " + filename);
+#endif
+    }
+
+private:
+#ifdef DYNARRAY_HAS_MMAP
+    void map() {
+        int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+        void* p = ::mmap(nullptr, length, protection, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("Не удалось отобразить файл " + filename);
+        bytes = static_cast<char*>(p);
+    }
+
+    int fd = -1;
+#else
+    std::vector<char> copy;
+#endif
+    std::string filename;
+    bool writable;
+    Advice advice = Advice::Normal;
+    char* bytes = nullptr;
+    size_t length = 0;
+};
+
+// Ошибка разбора текстового файла; offset - смещение токена от начала файла
+class TextParseError : public std::runtime_error {
+public:
+    TextParseError(const std::string& message, size_t offset)
+        : std::runtime_error(message), offset(offset) {}
+
+    size_t offset;
+};
+
+// Источник памяти для буфера DynArray. reallocate может перенести блок;
+// по умолчанию выделяет новый, копирует used байт и освобождает старый.
+class DynAllocator {
+public:
+    virtual ~DynAllocator() = default;
+
+    virtual void* allocate(size_t bytes) = 0;
+    virtual void deallocate(void* p, size_t bytes) = 0;
+
+    virtual void* reallocate(void* p, size_t oldBytes, size_t newBytes, size_t used) {
+        void* q = allocate(newBytes);
+        if (used > 0)
+            std::memcpy(q, p, used);
+        deallocate(p, oldBytes);
+        return q;
+    }
+
+    // Общий распределитель по умолчанию (malloc/realloc)
+    static DynAllocator& heap();
+};
+
+// malloc/realloc/free: realloc часто растит блок на месте, а большие
+// блоки glibc переносит через mremap без копирования
+class HeapAllocator : public DynAllocator {
+public:
+    void* allocate(size_t bytes) override {
+        void* p = std::malloc(bytes ? bytes : 1);
+        if (!p)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    void deallocate(void* p, size_t) override {
+        std::free(p);
+    }
+
+    void* reallocate(void* p, size_t, size_t newBytes, size_t) override {
+        void* q = std::realloc(p, newBytes ? newBytes : 1);
+        if (!q)
+            throw std::bad_alloc();
+        return q;
+    }
+};
+
+inline DynAllocator& DynAllocator::heap() {
+    static HeapAllocator instance;
+    return instance;
+}
+
+// Анонимные отображения, выровненные на 2 МиБ, с подсказкой ядру
+// использовать большие страницы. Рост через mremap (Linux) не копирует
+// данные. Каждый буфер занимает минимум 2 МиБ - только для больших массивов.
+class HugePageAllocator : public DynAllocator {
+public:
+    static constexpr size_t kPageBytes = 2 << 20;
+
+#ifdef DYNARRAY_HAS_MMAP
+    void* allocate(size_t bytes) override {
+        void* p = ::mmap(nullptr, roundUp(bytes), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+        adviseHuge(p, roundUp(bytes));
+        return p;
+    }
+
+    void deallocate(void* p, size_t bytes) override {
+        if (p)
+            ::munmap(p, roundUp(bytes));
+    }
+
+    void* reallocate(void* p, size_t oldBytes, size_t newBytes, size_t used) override {
+        if (roundUp(oldBytes) == roundUp(newBytes))
+            return p;
+#if defined(__linux__) && defined(MREMAP_MAYMOVE)
+        (void)used;
+        void* q = ::mremap(p, roundUp(oldBytes), roundUp(newBytes), MREMAP_MAYMOVE);
+        if (q == MAP_FAILED)
+            throw std::bad_alloc();
+        adviseHuge(q, roundUp(newBytes));
+        return q;
+#else
+        return DynAllocator::reallocate(p, oldBytes, newBytes, used);
+#endif
+    }
+
+private:
+    static size_t roundUp(size_t bytes) {
+        return (std::max<size_t>(bytes, 1) + kPageBytes - 1) / kPageBytes * kPageBytes;
+    }
+
+    static void adviseHuge(void* p, size_t bytes) {
+#ifdef MADV_HUGEPAGE
+        ::madvise(p, bytes, MADV_HUGEPAGE);
+#else
+        (void)p;
+        (void)bytes;
+#endif
+    }
+#else
+    // Без mmap - обычная куча
+    void* allocate(size_t bytes) override {
+        return DynAllocator::heap().allocate(bytes);
+    }
+
+    void deallocate(void* p, size_t bytes) override {
+        DynAllocator::heap().deallocate(p, bytes);
+    }
+
+    void* reallocate(void* p, size_t oldBytes, size_t newBytes, size_t used) override {
+        return DynAllocator::heap().reallocate(p, oldBytes, newBytes, used);
+    }
+#endif
+};
+
+// Арена: память выдаётся подряд из крупных блоков и возвращается только
+// при уничтожении арены. Последний выделенный буфер растёт на месте, пока
+// хватает блока. Не потокобезопасна; должна жить дольше своих массивов.
+class ArenaAllocator : public DynAllocator {
+public:
+    explicit ArenaAllocator(size_t blockBytes = 1 << 20)
+        : blockBytes(blockBytes) {}
+
+    ArenaAllocator(const ArenaAllocator&) = delete;
+    ArenaAllocator& operator=(const ArenaAllocator&) = delete;
+
+    void* allocate(size_t bytes) override {
+        bytes = align(bytes);
+        if (blocks.empty() || blockSize - used < bytes) {
+            blockSize = align(std::max(blockBytes, bytes));
+            blocks.emplace_back(new std::max_align_t[blockSize / sizeof(std::max_align_t)]);
+            used = 0;
+        }
+        last = reinterpret_cast<char*>(blocks.back().get()) + used;
+        used += bytes;
+        return last;
+    }
+
+    // Освобождается только последний буфер блока, остальные - вместе с ареной
+    void deallocate(void* p, size_t bytes) override {
+        if (p && p == last) {
+            used -= align(bytes);
+            last = nullptr;
+        }
+    }
+
+    void* reallocate(void* p, size_t oldBytes, size_t newBytes, size_t used) override {
+        if (p && p == last && this->used - align(oldBytes) + align(newBytes) <= blockSize) {
+            this->used += align(newBytes) - align(oldBytes);
+            return p;
+        }
+        return DynAllocator::reallocate(p, oldBytes, newBytes, used);
+    }
+
+private:
+    static size_t align(size_t bytes) {
+        const size_t a = sizeof(std::max_align_t);
+        return (std::max<size_t>(bytes, 1) + a - 1) / a * a;
+    }
+
+    size_t blockBytes;
+    std::vector<std::unique_ptr<std::max_align_t[]>> blocks;
+    size_t blockSize = 0;
+    size_t used = 0;
+    void* last = nullptr;
+};
+
+// Буфер в файле: элементы лежат прямо в отображении MappedFile после
+// offset байт заголовка, рост меняет длину файла (ftruncate + mremap, без
+// копирования). Файлу принадлежит один буфер - первый выделенный; другие
+// (например, копии массива) берутся из кучи. deallocate файл не удаляет.
+class MappedFileAllocator : public DynAllocator {
+public:
+    MappedFileAllocator(std::shared_ptr<MappedFile> file, size_t offset)
+        : file(std::move(file)), offset(offset) {}
+
+    void* allocate(size_t bytes) override {
+        if (inFile)
+            return DynAllocator::heap().allocate(bytes);
+        file->resize(offset + bytes);
+        inFile = true;
+        return buffer();
+    }
+
+    void deallocate(void* p, size_t bytes) override {
+        if (inFile && p == buffer())
+            inFile = false;
+        else
+            DynAllocator::heap().deallocate(p, bytes);
+    }
+
+    void* reallocate(void* p, size_t oldBytes, size_t newBytes, size_t used) override {
+        if (!inFile || p != buffer())
+            return DynAllocator::heap().reallocate(p, oldBytes, newBytes, used);
+        file->resize(offset + newBytes);
+        return buffer();
+    }
+
+private:
+    void* buffer() { return file->mutableData() + offset; }
+
+    std::shared_ptr<MappedFile> file;
+    size_t offset;
+    bool inFile = false;
+};
+
+// Правило роста ёмкости, когда добавляемые элементы не помещаются
+class GrowthPolicy {
+public:
+    enum class Kind { Doubling, OneAndHalf, FixedChunk, Exact };
+
+    static GrowthPolicy doubling() { return GrowthPolicy(Kind::Doubling, 0); }
+    static GrowthPolicy oneAndHalf() { return GrowthPolicy(Kind::OneAndHalf, 0); }
+    static GrowthPolicy fixedChunk(size_t chunk) { return GrowthPolicy(Kind::FixedChunk, chunk ? chunk : 1); }
+    // Ровно столько, сколько нужно: размер известен заранее через reserve
+    static GrowthPolicy exact() { return GrowthPolicy(Kind::Exact, 0); }
+
+    // Новая ёмкость не меньше required
+    size_t next(size_t capacity, size_t required) const {
+        size_t grown = required;
+        switch (kind) {
+        case Kind::Doubling:
+            grown = capacity ? capacity * 2 : 1;
+            break;
+        case Kind::OneAndHalf:
+            grown = capacity + capacity / 2 + 1;
+            break;
+        case Kind::FixedChunk:
+            grown = (required + chunk - 1) / chunk * chunk;
+            break;
+        case Kind::Exact:
+            break;
+        }
+        return std::max(grown, required);
+    }
+
+private:
+    GrowthPolicy(Kind kind, size_t chunk) : kind(kind), chunk(chunk) {}
+
+    Kind kind;
+    size_t chunk;
+};
 
 class DynArray {
 protected:
     int* data;
     size_t size;
     size_t capacity;
+    // Владелец внешнего буфера (например, отображённого файла).
+    // Если задан, data не принадлежит массиву и не освобождается allocator.
+    std::shared_ptr<const void> storage;
+    DynAllocator* allocator;
+    GrowthPolicy growth = GrowthPolicy::doubling();
+
+    // Представление чужого буфера без копирования. При первом push_back
+    // элементы переносятся в собственный буфер, чужой буфер не изменяется.
+    DynArray(int* external, size_t count, std::shared_ptr<const void> owner)
+        : data(external), size(count), capacity(count), storage(std::move(owner)),
+          allocator(&DynAllocator::heap()) {}
 
 public:
-    DynArray(size_t capacity = 10)
-        : size(0), capacity(capacity)
+    // allocator должен жить дольше массива и его снимков
+    DynArray(size_t capacity = 10, DynAllocator& allocator = DynAllocator::heap())
+        : size(0), capacity(capacity), allocator(&allocator)
     {
-        data = new int[capacity];
+        data = static_cast<int*>(allocator.allocate(capacity * sizeof(int)));
     }
 
-    virtual ~DynArray() {
-        delete[] data;
+    // Копия берёт буфер из кучи: allocator оригинала (арена, файл
+    // ArrMapped) может умереть раньше копии. Присваивание оставляет свой
+    // allocator - как pmr-контейнеры
+    DynArray(const DynArray& other)
+        : size(other.size), capacity(other.size), allocator(&DynAllocator::heap()), growth(other.growth)
+    {
+        data = static_cast<int*>(allocator->allocate(capacity * sizeof(int)));
+        if (size > 0)
+            std::memcpy(data, other.data, size * sizeof(int));
     }
 
-    void push_back(int value) {
-        if (size >= capacity) {
-            // увеличиваем массив
-            capacity *= 2;
-            int* newdata = new int[capacity];
+    // Перенос забирает буфер (и владельца чужого буфера) без копирования
+    DynArray(DynArray&& other) noexcept
+        : data(other.data), size(other.size), capacity(other.capacity),
+          storage(std::move(other.storage)), allocator(other.allocator), growth(other.growth)
+    {
+        other.data = nullptr;
+        other.size = 0;
+        other.capacity = 0;
+    }
 
-            for (size_t i = 0; i < size; i++)
-                newdata[i] = data[i];
+    DynArray& operator=(const DynArray& other) {
+        if (this != &other) {
+            int* fresh = static_cast<int*>(allocator->allocate(other.size * sizeof(int)));
+            if (other.size > 0)
+                std::memcpy(fresh, other.data, other.size * sizeof(int));
+            release();
+            data = fresh;
+            size = other.size;
+            capacity = other.size;
+            growth = other.growth;
+        }
+        return *this;
+    }
 
-            delete[] data;
-            data = newdata;
+    DynArray& operator=(DynArray&& other) noexcept {
+        if (this != &other) {
+            release();
+            data = other.data;
+            size = other.size;
+            capacity = other.capacity;
+            storage = std::move(other.storage);
+            allocator = other.allocator;
+            growth = other.growth;
+            other.data = nullptr;
+            other.size = 0;
+            other.capacity = 0;
         }
+        return *this;
+    }
+
+    virtual ~DynArray() {
+        release();
+    }
+
+    void push_back(int value) {
+        if (size >= capacity)
+            grow(size + 1);
         data[size++] = value;
     }
 
+    // Добавление count элементов одним копированием (values может
+    // указывать внутрь самого массива)
+    void append(const int* values, size_t count) {
+        if (count == 0)
+            return;
+        if (size + count > capacity) {
+            bool inside = values >= data && values < data + size;
+            size_t offset = inside ? values - data : 0;
+            grow(size + count);
+            if (inside)
+                values = data + offset;
+        }
+        std::memcpy(data + size, values, count * sizeof(int));
+        size += count;
+    }
+
+    void append(const std::vector<int>& values) {
+        append(values.data(), values.size());
+    }
+
+    void reserve(size_t count) {
+        if (count > capacity)
+            relocate(count);
+    }
+
+    void shrink_to_fit() {
+        if (capacity > size)
+            relocate(size);
+    }
+
+    void setGrowthPolicy(GrowthPolicy policy) { growth = policy; }
+
     size_t getSize() const { return size; }
+    size_t getCapacity() const { return capacity; }
     int operator[](size_t i) const { return data[i]; }
 
-    virtual void save() = 0;  // Виртуальный метод
+    // Элементы подряд - для append и range-for
+    const int* begin() const { return data; }
+    const int* end() const { return data + size; }
+
+    // Массовые операции на общем пуле потоков (parallel.h); массив короче
+    // двух задач обрабатывается в вызывающем потоке. Изменяющие операции
+    // сначала переносят замороженный или чужой буфер в собственный.
+    template<typename Fn>
+    void transform(Fn fn) {
+        makeWritable();
+        parallelTransform(data, size, data, fn);
+    }
+
+    // По возрастанию, поразрядной сортировкой
+    void sort() {
+        makeWritable();
+        parallelSort(data, size);
+    }
+
+    template<typename R, typename Op>
+    R reduce(R identity, Op op) const {
+        return parallelReduce(data, size, identity, op);
+    }
+
+    int min() const { return data[parallelMinMax(data, size).first]; }
+    int max() const { return data[parallelMinMax(data, size).second]; }
+
+    template<typename Pred>
+    size_t countIf(Pred pred) const {
+        return parallelCountIf(data, size, pred);
+    }
+
+    // Индекс первого элемента, для которого pred истинен, или getSize()
+    template<typename Pred>
+    size_t find(Pred pred) const {
+        return parallelFind(data, size, pred);
+    }
+
+    virtual SaveStats save() {  // Виртуальный метод
+        return timedSnapshot(data, size);
+    }
+
+    // Фоновое сохранение: текущие элементы [0, size) замораживаются без
+    // копирования и пишутся отдельным потоком, а push_back продолжает
+    // работать. Массив должен жить, пока не получен результат future.
+    virtual std::future<SaveStats> saveAsync() {
+        std::shared_ptr<const void> pin = freeze();
+        const int* values = data;
+        size_t count = size;
+        return std::async(std::launch::async, [this, pin, values, count]() {
+            return timedSnapshot(values, count);
+        });
+    }
+
 protected:
-    static std::string getCurrentDateTime() {
-        auto t = std::time(nullptr);
+    // Запись values[0..count) в новый файл своего формата
+    virtual SaveStats writeSnapshot(const int* values, size_t count) const = 0;
+
+    // writeSnapshot с учётом в инструментировании (время и объём сохранения)
+    SaveStats timedSnapshot(const int* values, size_t count) const {
+        INSTR_COUNT("save.calls");
+        INSTR_SCOPE_TIMER("save.ns");
+        SaveStats stats = writeSnapshot(values, count);
+        if (stats.file.empty())
+            INSTR_COUNT("save.failed");
+        INSTR_RECORD("save.bytes", stats.bytes);
+        return stats;
+    }
+
+    // Сколько первых элементов values[0..count) поместится в файл своего
+    // формата не больше maxBytes. Формат, не умеющий оценить размер,
+    // размер не ограничивает.
+    virtual size_t fitInBytes(const int* values, size_t count, size_t maxBytes) const {
+        (void)values;
+        (void)maxBytes;
+        return count;
+    }
+
+    // Передаёт текущий буфер во владение shared_ptr и возвращает его.
+    // Элементы [0, size) больше не меняются: push_back пишет только после
+    // size, а при росте копирует в новый буфер и отпускает свою ссылку,
+    // так что старый буфер живёт, пока нужен снимку.
+    std::shared_ptr<const void> freeze() {
+        if (!storage) {
+            DynAllocator* owner = allocator;
+            size_t bytes = capacity * sizeof(int);
+            storage = std::shared_ptr<const int>(data, [owner, bytes](const int* p) {
+                owner->deallocate(const_cast<int*>(p), bytes);
+            });
+        }
+        return storage;
+    }
+
+    // Собственный буфер перед изменением элементов на месте: снимок
+    // saveAsync или отображённый файл остаются нетронутыми
+    void makeWritable() {
+        if (storage)
+            relocate(capacity);
+    }
+
+    void grow(size_t required) {
+        INSTR_COUNT("dynarray.grow");
+        INSTR_SCOPE_TIMER("dynarray.grow_ns");
+        if (required > SIZE_MAX / sizeof(int))
+            throw std::length_error("Слишком большой размер массива");
+        relocate(std::min(growth.next(capacity, required), SIZE_MAX / sizeof(int)));
+    }
+
+    // Смена ёмкости. Собственный буфер растёт через allocator->reallocate
+    // (realloc/mremap, без поэлементного копирования); замороженный или
+    // чужой буфер не трогается - элементы копируются в новый (после
+    // переноса буфера нет вовсе - выделяется новый).
+    void relocate(size_t newCapacity) {
+        if (storage || !data) {
+            int* fresh = static_cast<int*>(allocator->allocate(newCapacity * sizeof(int)));
+            if (size > 0)
+                std::memcpy(fresh, data, size * sizeof(int));
+            storage.reset();
+            data = fresh;
+        } else {
+            data = static_cast<int*>(allocator->reallocate(data, capacity * sizeof(int),
+                                                           newCapacity * sizeof(int),
+                                                           size * sizeof(int)));
+        }
+        capacity = newCapacity;
+    }
+
+    void release() {
+        if (!storage && data)
+            allocator->deallocate(data, capacity * sizeof(int));
+        storage.reset();
+        data = nullptr;
+    }
+
+    // Общий вывод для текстовых форматов: элементы через разделитель,
+    // delimAfterLast - ставить ли разделитель после последнего элемента
+    static SaveStats writeDelimited(std::ostream& out, const int* values, size_t count,
+                                    char delim, bool delimAfterLast) {
+        SaveStats stats;
+        FormatBuffer fmt(out);
+        for (size_t i = 0; i < count; i++) {
+            fmt.putInt(values[i]);
+            if (delimAfterLast || i + 1 < count)
+                fmt.putChar(delim);
+        }
+        fmt.flush();
+        stats.bytes = fmt.bytes();
+        stats.elements = count;
+        return stats;
+    }
+
+    // Запись текстового формата в файл filename. Большие массивы форматируются
+    // параллельно (writeDelimitedParallel), остальные - одним потоком.
+    static SaveStats writeDelimitedFile(const std::string& filename, const int* values,
+                                        size_t count, char delim, bool delimAfterLast) {
+#ifdef DYNARRAY_HAS_MMAP
+        size_t workers = std::min(ThreadPool::shared().getThreads(), count / kMinParallelSaveElements);
+        if (workers > 1)
+            return writeDelimitedParallel(filename, values, count, delim, delimAfterLast, workers);
+#endif
+        std::ofstream out(filename);
+
+        if (!out) {
+            std::cerr << "Ошибка открытия файла!\n";
+            return SaveStats();
+        }
+
+        SaveStats stats = writeDelimited(out, values, count, delim, delimAfterLast);
+        stats.file = filename;
+        if (!out) {
+            std::cerr << "Ошибка записи файла!\n";
+            return SaveStats();
+        }
+        return stats;
+    }
+
+#ifdef DYNARRAY_HAS_MMAP
+    // Меньше этого числа элементов на поток параллельная запись не окупается
+    static constexpr size_t kMinParallelSaveElements = 1 << 18;
+
+    // Массив делится на workers непрерывных кусков. Первый проход считает
+    // длину текста каждого куска, префиксные суммы дают смещения кусков в
+    // файле; второй проход форматирует каждый кусок в свой буфер и пишет
+    // его через pwrite сразу на своё место. Результат побайтно совпадает с
+    // последовательной записью.
+    static SaveStats writeDelimitedParallel(const std::string& filename, const int* values,
+                                            size_t count, char delim, bool delimAfterLast,
+                                            size_t workers) {
+        int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) {
+            std::cerr << "Ошибка открытия файла!\n";
+            return SaveStats();
+        }
+
+        std::vector<size_t> bounds(workers + 1);
+        for (size_t w = 0; w <= workers; w++)
+            bounds[w] = count / workers * w + std::min(w, count % workers);
+
+        // Проход 1: длина текста каждого куска
+        std::vector<size_t> offsets(workers + 1, 0);
+        parallelChunks(workers, 1, nullptr, [&](size_t w, size_t, size_t) {
+            size_t bytes = 0;
+            for (size_t i = bounds[w]; i < bounds[w + 1]; i++)
+                bytes += decimalLength(values[i]) + 1;
+            if (!delimAfterLast && bounds[w + 1] == count && count > 0)
+                bytes--;
+            offsets[w + 1] = bytes;
+        });
+        for (size_t w = 0; w < workers; w++)
+            offsets[w + 1] += offsets[w];
+
+        // Проход 2: форматирование и запись на свои места
+        std::atomic<bool> failed{false};
+        parallelChunks(workers, 1, nullptr, [&](size_t w, size_t, size_t) {
+            std::vector<char> buf(FormatBuffer::kCapacity);
+            char* begin = buf.data();
+            char* end = begin + buf.size();
+            char* p = begin;
+            off_t pos = static_cast<off_t>(offsets[w]);
+
+            auto flush = [&]() {
+                for (const char* q = begin; q < p && !failed;) {
+                    ssize_t n = ::pwrite(fd, q, p - q, pos);
+                    if (n <= 0) {
+                        failed = true;
+                        break;
+                    }
+                    q += n;
+                    pos += n;
+                }
+                p = begin;
+            };
+
+            for (size_t i = bounds[w]; i < bounds[w + 1]; i++) {
+                if (end - p < static_cast<ptrdiff_t>(FormatBuffer::kMaxIntChars + 1))
+                    flush();
+                p = std::to_chars(p, end, values[i]).ptr;
+                if (delimAfterLast || i + 1 < count)
+                    *p++ = delim;
+            }
+            flush();
+        });
+
+        if (::close(fd) != 0 || failed) {
+            std::cerr << "Ошибка записи файла!\n";
+            return SaveStats();
+        }
+
+        SaveStats stats;
+        stats.file = filename;
+        stats.bytes = offsets[workers];
+        stats.elements = count;
+        return stats;
+    }
+#endif
+
+    // fitInBytes для текстовых форматов: число и один разделитель на элемент
+    static size_t fitDelimited(const int* values, size_t count, size_t maxBytes) {
+        size_t bytes = 0;
+        for (size_t i = 0; i < count; i++) {
+            bytes += decimalLength(values[i]) + 1;
+            if (bytes > maxBytes)
+                return i;
+        }
+        return count;
+    }
+
+    static size_t decimalLength(int value) {
+        uint32_t u = value < 0 ? 0u - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);
+        size_t len = value < 0 ? 2 : 1;
+        for (; u >= 10; u /= 10)
+            len++;
+        return len;
+    }
+
+    // Разделители текстовых форматов: TXT пишет '\n', CSV - ','
+    static bool isTextSeparator(char c) {
+        return c == ',' || c == '\n' || c == '\r' || c == ' ' || c == '\t';
+    }
+
+    // Параллельная загрузка TXT/CSV. Файл отображается в память и делится
+    // на куски по границам разделителей; первый проход считает числа в
+    // каждом куске, по префиксным суммам выделяется итоговый массив (одно
+    // выделение), второй проход разбирает куски через std::from_chars
+    // прямо на свои места.
+    template<typename Arr>
+    static std::unique_ptr<Arr> loadText(const std::string& filename) {
+        const size_t kMinChunkBytes = 1 << 20;
+
+        MappedFile file(filename);
+        const char* text = file.data();
+        const size_t length = file.size();
+
+        size_t workers = std::min(ThreadPool::shared().getThreads(), length / kMinChunkBytes + 1);
+        std::vector<size_t> bounds(workers + 1, length);
+        bounds[0] = 0;
+        for (size_t w = 1; w < workers; w++) {
+            size_t b = std::max(bounds[w - 1], length / workers * w);
+            while (b < length && !isTextSeparator(text[b - 1]))
+                b++;
+            bounds[w] = b;
+        }
+
+        // Проход 1: количество чисел в каждом куске
+        std::vector<size_t> offsets(workers + 1, 0);
+        parallelChunks(workers, 1, nullptr, [&](size_t w, size_t, size_t) {
+            size_t count = 0;
+            bool inToken = false;
+            for (size_t i = bounds[w]; i < bounds[w + 1]; i++) {
+                bool sep = isTextSeparator(text[i]);
+                if (!sep && !inToken)
+                    count++;
+                inToken = !sep;
+            }
+            offsets[w + 1] = count;
+        });
+        for (size_t w = 0; w < workers; w++)
+            offsets[w + 1] += offsets[w];
+
+        // Проход 2: разбор на свои места в итоговом массиве
+        std::unique_ptr<Arr> arr(new Arr(offsets[workers]));
+        DynArray& out = *arr;
+        parallelChunks(workers, 1, nullptr, [&](size_t w, size_t, size_t) {
+            int* dst = out.data + offsets[w];
+            size_t i = bounds[w];
+            const size_t end = bounds[w + 1];
+            while (i < end) {
+                if (isTextSeparator(text[i])) {
+                    i++;
+                    continue;
+                }
+                size_t tokenEnd = i;
+                while (tokenEnd < end && !isTextSeparator(text[tokenEnd]))
+                    tokenEnd++;
+
+                auto res = std::from_chars(text + i, text + tokenEnd, *dst);
+                if (res.ec != std::errc() || res.ptr != text + tokenEnd) {
+                    std::string token(text + i, std::min<size_t>(tokenEnd - i, 32));
+                    throw TextParseError("Некорректное число \"" + token + "\" в файле " +
+                                         filename + " по смещению " + std::to_string(i), i);
+                }
+                dst++;
+                i = tokenEnd;
+            }
+        });
+        out.size = offsets[workers];
+        return arr;
+    }
+
+    // Уникальное имя нового файла: дата и время до микросекунд плюс
+    // номер сохранения в процессе, например 2026-10-16_09-51-40.123456-000007.bin.
+    // Строка даты пересчитывается только при смене секунды.
+    static std::string makeFileName(const char* ext) {
+        static std::mutex cacheMutex;
+        static std::time_t cachedSecond = -1;
+        static std::string cachedPrefix;
+        static std::atomic<uint64_t> sequence{0};
+
+        auto now = std::chrono::system_clock::now().time_since_epoch();
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+        std::time_t second = static_cast<std::time_t>(micros / 1000000);
+        uint64_t seq = sequence.fetch_add(1, std::memory_order_relaxed);
+
+        std::string name;
+        {
+            std::lock_guard<std::mutex> lock(cacheMutex);
+            if (second != cachedSecond) {
+                cachedPrefix = getCurrentDateTime(second);
+                cachedSecond = second;
+            }
+            name = cachedPrefix;
+        }
+
+        char suffix[32];
+        char* end = suffix + sizeof(suffix);
+        char* p = suffix;
+        *p++ = '.';
+        p = putPadded(p, end, static_cast<uint64_t>(micros % 1000000), 6);
+        *p++ = '-';
+        p = putPadded(p, end, seq, 6);
+        name.append(suffix, p);
+        return name + ext;
+    }
+
+    // Число с ведущими нулями до width знаков
+    static char* putPadded(char* p, char* end, uint64_t value, size_t width) {
+        char digits[20];
+        size_t n = std::to_chars(digits, digits + sizeof(digits), value).ptr - digits;
+        for (; n < width && p < end; width--)
+            *p++ = '0';
+        return std::copy(digits, digits + n, p);
+    }
+
+    static std::string getCurrentDateTime(std::time_t t = std::time(nullptr)) {
         std::tm* now = std::localtime(&t);
 
         std::ostringstream oss;
@@ -63,19 +1065,24 @@ class ArrTxt : public DynArray {
 public:
     using DynArray::DynArray;
 
-    void save() override {
-        std::string filename = getCurrentDateTime() + ".txt";
-        std::ofstream out(filename);
+    // Загрузка файла, записанного save() (параллельный разбор)
+    static std::unique_ptr<ArrTxt> load(const std::string& filename) {
+        return loadText<ArrTxt>(filename);
+    }
 
-        if (!out) {
-            std::cerr << "Ошибка открытия файла!\n";
-            return;
-        }
+protected:
+    size_t fitInBytes(const int* values, size_t count, size_t maxBytes) const override {
+        return fitDelimited(values, count, maxBytes);
+    }
 
-        for (size_t i = 0; i < size; i++)
-            out << data[i] << "\n";
+    SaveStats writeSnapshot(const int* values, size_t count) const override {
+        std::string filename = makeFileName(".txt");
+        SaveStats stats = writeDelimitedFile(filename, values, count, '\n', true);
+        if (stats.file.empty())
+            return SaveStats();
 
-        std::cout << "Файл TXT сохранён: " << filename << "\n";
+        std::cout << "Файл TXT сохранён: " + filename + "\n";
+        return stats;
     }
 };
 
@@ -84,41 +1091,1348 @@ class ArrCSV : public DynArray {
 public:
     using DynArray::DynArray;
 
-    void save() override {
-        std::string filename = getCurrentDateTime() + ".csv";
-        std::ofstream out(filename);
+    // Загрузка файла, записанного save() (параллельный разбор)
+    static std::unique_ptr<ArrCSV> load(const std::string& filename) {
+        return loadText<ArrCSV>(filename);
+    }
 
-        if (!out) {
-            std::cerr << "Ошибка открытия файла!\n";
-            return;
-        }
+protected:
+    size_t fitInBytes(const int* values, size_t count, size_t maxBytes) const override {
+        return fitDelimited(values, count, maxBytes);
+    }
 
-        for (size_t i = 0; i < size; i++)
-            out << data[i] << (i + 1 < size ? "," : "");
+    SaveStats writeSnapshot(const int* values, size_t count) const override {
+        std::string filename = makeFileName(".csv");
+        SaveStats stats = writeDelimitedFile(filename, values, count, ',', false);
+        if (stats.file.empty())
+            return SaveStats();
 
-        std::cout << "Файл CSV сохранён: " << filename << "\n";
+        std::cout << "Файл CSV сохранён: " + filename + "\n";
+        return stats;
     }
 };
 
-// MAIN
-int main() {
-    ArrTxt arrTxt;
+inline bool hostIsLittleEndian() {
+    const uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+inline uint32_t byteSwap32(uint32_t v) {
+    return (v >> 24) | ((v >> 8) & 0xFF00u) | ((v << 8) & 0xFF0000u) | (v << 24);
+}
+
+// Запись/чтение целого little-endian шириной width байт (заголовки файлов)
+inline void storeLE(char* out, uint64_t value, int width) {
+    for (int i = 0; i < width; i++)
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+inline uint64_t loadLE(const char* in, int width) {
+    uint64_t value = 0;
+    for (int i = 0; i < width; i++)
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+    return value;
+}
+
+// Контрольная сумма Fletcher-64 по 32-битным словам (значениям элементов)
+// Состояние суммы Флетчера: update по частям даёт то же, что один вызов
+// по всем элементам
+struct Fletcher64 {
+    uint64_t a = 0;
+    uint64_t b = 0;
+
+    void update(const int* values, size_t count) {
+        const uint64_t mod = 0xFFFFFFFFull;
+        const size_t block = 32768;  // за блок суммы не переполняют uint64_t
+        while (count > 0) {
+            size_t n = count < block ? count : block;
+            for (size_t i = 0; i < n; i++) {
+                a += static_cast<uint32_t>(values[i]);
+                b += a;
+            }
+            a %= mod;
+            b %= mod;
+            values += n;
+            count -= n;
+        }
+    }
+
+    uint64_t value() const { return (b << 32) | a; }
+};
+
+inline uint64_t fletcher64(const int* values, size_t count) {
+    Fletcher64 sum;
+    sum.update(values, count);
+    return sum.value();
+}
+
+// Запись элементов в поток как int32 little-endian
+inline void writeInts(std::ostream& out, const int* values, size_t count) {
+    if (hostIsLittleEndian()) {
+        out.write(reinterpret_cast<const char*>(values), count * sizeof(int));
+        return;
+    }
+    std::vector<uint32_t> chunk(FormatBuffer::kCapacity / sizeof(uint32_t));
+    for (size_t done = 0; done < count; ) {
+        size_t n = std::min(chunk.size(), count - done);
+        for (size_t i = 0; i < n; i++)
+            chunk[i] = byteSwap32(static_cast<uint32_t>(values[done + i]));
+        out.write(reinterpret_cast<const char*>(chunk.data()), n * sizeof(uint32_t));
+        done += n;
+    }
+}
+
+// Чтение count элементов int32 little-endian (src может быть не выровнен)
+inline void readInts(const char* src, size_t count, int* dst) {
+    std::memcpy(dst, src, count * sizeof(int));
+    if (!hostIsLittleEndian()) {
+        for (size_t i = 0; i < count; i++)
+            dst[i] = static_cast<int>(byteSwap32(static_cast<uint32_t>(dst[i])));
+    }
+}
+
+// Заголовок формата BIN: 32 байта, все поля little-endian
+struct BinHeader {
+    static constexpr uint32_t kMagic = 0x4E424144;  // "DABN"
+    static constexpr uint16_t kVersion = 1;
+    static constexpr size_t kSize = 32;
+
+    uint32_t magic = kMagic;
+    uint16_t version = kVersion;
+    uint8_t elemWidth = sizeof(int32_t);
+    uint8_t littleEndian = 1;
+    uint64_t count = 0;
+    uint64_t checksum = 0;
+    uint64_t reserved = 0;
+
+    void encode(char* out) const {
+        storeLE(out, magic, 4);
+        storeLE(out + 4, version, 2);
+        storeLE(out + 6, elemWidth, 1);
+        storeLE(out + 7, littleEndian, 1);
+        storeLE(out + 8, count, 8);
+        storeLE(out + 16, checksum, 8);
+        storeLE(out + 24, reserved, 8);
+    }
+
+    static BinHeader decode(const char* in) {
+        BinHeader h;
+        h.magic = static_cast<uint32_t>(loadLE(in, 4));
+        h.version = static_cast<uint16_t>(loadLE(in + 4, 2));
+        h.elemWidth = static_cast<uint8_t>(loadLE(in + 6, 1));
+        h.littleEndian = static_cast<uint8_t>(loadLE(in + 7, 1));
+        h.count = loadLE(in + 8, 8);
+        h.checksum = loadLE(in + 16, 8);
+        h.reserved = loadLE(in + 24, 8);
+        return h;
+    }
+
+};
+
+// BIN Class: заголовок BinHeader и элементы как int32 little-endian
+class ArrBin : public DynArray {
+public:
+    using DynArray::DynArray;
+
+    // Загрузка без копирования: файл отображается в память, и массив
+    // ссылается прямо на его содержимое (только чтение). verifyChecksum
+    // включает проверку контрольной суммы - это один проход по данным.
+    static std::unique_ptr<ArrBin> load(const std::string& filename, bool verifyChecksum = false) {
+        auto file = std::make_shared<MappedFile>(filename);
+        BinHeader h = checkHeader(*file, filename);
+        const char* payload = file->data() + BinHeader::kSize;
+        size_t count = static_cast<size_t>(h.count);
+        std::unique_ptr<ArrBin> arr;
+
+        if (hostIsLittleEndian() && reinterpret_cast<uintptr_t>(payload) % alignof(int) == 0) {
+            int* values = const_cast<int*>(reinterpret_cast<const int*>(payload));
+            arr.reset(new ArrBin(values, count, file));
+        } else {
+            // Другой порядок байт или невыровненные данные - копируем
+            arr.reset(new ArrBin(count));
+            readInts(payload, count, arr->data);
+            arr->size = count;
+        }
+
+        if (verifyChecksum && fletcher64(arr->data, count) != h.checksum)
+            throw std::runtime_error("Контрольная сумма файла " + filename + " не совпадает");
+
+        return arr;
+    }
+
+    // Запись в поток заголовка и элементов формата BIN
+    static SaveStats writeBinary(std::ostream& out, const int* values, size_t count) {
+        BinHeader h;
+        h.count = count;
+        h.checksum = fletcher64(values, count);
+
+        char header[BinHeader::kSize];
+        h.encode(header);
+        out.write(header, sizeof(header));
+
+        writeInts(out, values, count);
+
+        SaveStats stats;
+        stats.bytes = BinHeader::kSize + count * sizeof(int32_t);
+        stats.elements = count;
+        return stats;
+    }
+
+protected:
+    // Заголовок отображённого BIN-файла; исключение, если файл не BIN или
+    // его длина не совпадает с числом элементов. allowTail допускает данные
+    // после count элементов (ArrMapped после сбоя до flush())
+    static BinHeader checkHeader(const MappedFile& file, const std::string& filename,
+                                 bool allowTail = false) {
+        if (file.size() < BinHeader::kSize)
+            throw std::runtime_error("Файл " + filename + " слишком мал для формата BIN");
+
+        BinHeader h = BinHeader::decode(file.data());
+        if (h.magic != BinHeader::kMagic || h.version != BinHeader::kVersion ||
+            h.elemWidth != sizeof(int32_t) || h.littleEndian != 1) {
+            throw std::runtime_error("Файл " + filename + " не в формате BIN или неподдерживаемой версии");
+        }
+
+        size_t payloadBytes = file.size() - BinHeader::kSize;
+        size_t payloadCount = payloadBytes / sizeof(int32_t);
+        bool fits = allowTail ? h.count <= payloadCount
+                              : payloadBytes % sizeof(int32_t) == 0 && h.count == payloadCount;
+        if (!fits)
+            throw std::runtime_error("Размер файла " + filename + " не совпадает с заголовком");
+        return h;
+    }
+
+    size_t fitInBytes(const int*, size_t count, size_t maxBytes) const override {
+        size_t room = maxBytes > BinHeader::kSize ? maxBytes - BinHeader::kSize : 0;
+        return std::min(count, room / sizeof(int32_t));
+    }
+
+    SaveStats writeSnapshot(const int* values, size_t count) const override {
+        std::string filename = makeFileName(".bin");
+        std::ofstream out(filename, std::ios::binary);
+
+        if (!out) {
+            std::cerr << "Ошибка открытия файла!\n";
+            return SaveStats();
+        }
+
+        SaveStats stats = writeBinary(out, values, count);
+        stats.file = filename;
+        if (!out) {
+            std::cerr << "Ошибка записи файла!\n";
+            return SaveStats();
+        }
+
+        std::cout << "Файл BIN сохранён: " + filename + "\n";
+        return stats;
+    }
+};
+
+// BIN-файл, открытый как буфер массива: элементы не читаются заранее, ОС
+// подгружает их страницами при обращении, поэтому открытие не зависит от
+// размера файла, а резидентная память - страничный кэш, который ядро
+// может вытеснить.
+// ReadOnly - представление без копирования, как ArrBin::load: первое
+// изменение переносит элементы в память. ReadWrite - push_back, append,
+// transform и sort пишут прямо в файл, рост идёт через MappedFileAllocator.
+// flush() (и деструктор) записывает в заголовок число элементов и
+// контрольную сумму - это один проход по данным - и обрезает файл по
+// размеру. save() пишет отдельный снимок, как у ArrBin.
+// После сбоя до flush() в заголовке остаётся число элементов последнего
+// flush(), а файл длиннее (запас ёмкости): open() принимает такой файл с
+// этим числом элементов, ReadWrite обрезает хвост (см. Durability).
+class ArrMapped : public ArrBin {
+public:
+    enum class Mode { ReadOnly, ReadWrite };
+
+    static std::unique_ptr<ArrMapped> open(const std::string& filename, Mode mode = Mode::ReadOnly,
+                                           MappedFile::Advice advice = MappedFile::Advice::Normal) {
+        auto file = std::make_shared<MappedFile>(filename, mode == Mode::ReadWrite);
+        // Хвост после count элементов обрезает первое выделение буфера
+        // в файле (MappedFileAllocator::allocate)
+        size_t count = static_cast<size_t>(checkHeader(*file, filename, true).count);
+        if (!hostIsLittleEndian())
+            throw std::runtime_error("Файл " + filename + " нельзя отобразить: другой порядок байт");
+        file->advise(advice);
+        if (mode == Mode::ReadOnly) {
+            int* values = const_cast<int*>(reinterpret_cast<const int*>(file->data() + BinHeader::kSize));
+            return std::unique_ptr<ArrMapped>(new ArrMapped(values, count, file));
+        }
+        return std::unique_ptr<ArrMapped>(new ArrMapped(file, count));
+    }
+
+    // Новый пустой BIN-файл (существующий перезаписывается), ReadWrite
+    static std::unique_ptr<ArrMapped> create(const std::string& filename) {
+        {
+            std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+            writeBinary(out, nullptr, 0);
+            if (!out.flush())
+                throw std::runtime_error("Не удалось создать файл " + filename);
+        }
+        return open(filename, Mode::ReadWrite);
+    }
+
+    ~ArrMapped() override {
+        try {
+            flush();
+        } catch (const std::exception& e) {
+            std::cerr << "Ошибка записи отображённого файла: " << e.what() << "\n";
+        }
+        // Буфер принадлежит файлу, а распределитель уничтожается раньше DynArray
+        if (fileAllocator)
+            data = nullptr;
+    }
+
+    ArrMapped(const ArrMapped&) = delete;
+    ArrMapped& operator=(const ArrMapped&) = delete;
+
+    bool isWritable() const { return fileAllocator != nullptr; }
+
+    void advise(MappedFile::Advice advice) { file->advise(advice); }
+
+    // Убрать элементы [first, last) из памяти процесса (см. MappedFile::evict);
+    // для массива в памяти - ничего не делает
+    void evict(size_t first, size_t last) {
+        if (!storage && !fileAllocator)
+            return;
+        last = std::min(last, size);
+        if (first < last)
+            file->evict(BinHeader::kSize + first * sizeof(int), (last - first) * sizeof(int));
+    }
+
+    // Заголовок по текущему содержимому, файл по размеру, запись на диск.
+    // Контрольная сумма считается окнами, пройденные окна выгружаются
+    void flush() {
+        if (!fileAllocator)
+            return;
+        shrink_to_fit();
+        Fletcher64 checksum;
+        for (size_t first = 0; first < size; first += kWindow) {
+            size_t n = std::min(kWindow, size - first);
+            checksum.update(data + first, n);
+            evict(first, first + n);
+        }
+        BinHeader h;
+        h.count = size;
+        h.checksum = checksum.value();
+        h.encode(file->mutableData());
+        file->sync();
+    }
+
+    // Буфер - это сам файл: заморозить его для фоновой записи нельзя
+    // (рост файла перемещает отображение), поэтому снимок пишется сразу
+    std::future<SaveStats> saveAsync() override {
+        std::promise<SaveStats> done;
+        done.set_value(save());
+        return done.get_future();
+    }
+
+private:
+    ArrMapped(int* values, size_t count, std::shared_ptr<MappedFile> owner)
+        : ArrBin(values, count, owner), file(std::move(owner)) {}
+
+    ArrMapped(std::shared_ptr<MappedFile> owner, size_t count)
+        : ArrMapped(owner, std::make_unique<MappedFileAllocator>(owner, BinHeader::kSize), count) {}
+
+    ArrMapped(std::shared_ptr<MappedFile> owner, std::unique_ptr<MappedFileAllocator> allocator, size_t count)
+        : ArrBin(count, *allocator), file(std::move(owner)), fileAllocator(std::move(allocator)) {
+        size = count;
+    }
+
+    static constexpr size_t kWindow = size_t(1) << 24;  // элементов на окно в flush()
+
+    std::shared_ptr<MappedFile> file;
+    std::unique_ptr<MappedFileAllocator> fileAllocator;  // только ReadWrite
+};
+
+// Кодек stream-vbyte для разностей соседних значений в zigzag-кодировании.
+// На каждые 4 числа приходится управляющий байт (по 2 бита на длину 1..4
+// байта), управляющие байты блока идут подряд, за ними - байты значений.
+class StreamVByte {
+public:
+    static uint32_t zigzag(uint32_t delta) {
+        return (delta << 1) ^ (0u - (delta >> 31));
+    }
+
+    static uint32_t unzigzag(uint32_t z) {
+        return (z >> 1) ^ (0u - (z & 1));
+    }
+
+    static size_t controlBytes(size_t count) {
+        return (count + 3) / 4;
+    }
+
+    // Сколько байт данных занимает число z
+    static int byteLength(uint32_t z) {
+        return z < (1u << 8) ? 1 : z < (1u << 16) ? 2 : z < (1u << 24) ? 3 : 4;
+    }
+
+    // Кодирует блок в out (нужно controlBytes(count) + 4 * count байт),
+    // возвращает число байт данных после управляющих байтов
+    static size_t encodeBlock(const int* values, size_t count, uint8_t* out) {
+        uint8_t* ctrl = out;
+        uint8_t* bytes = out + controlBytes(count);
+        uint8_t* begin = bytes;
+        uint32_t prev = 0;
+
+        for (size_t i = 0; i < count; i += 4) {
+            uint8_t c = 0;
+            for (size_t j = 0; j < 4 && i + j < count; j++) {
+                uint32_t v = static_cast<uint32_t>(values[i + j]);
+                uint32_t z = zigzag(v - prev);
+                prev = v;
+
+                int len = byteLength(z);
+                c |= static_cast<uint8_t>((len - 1) << (2 * j));
+                for (int k = 0; k < len; k++)
+                    *bytes++ = static_cast<uint8_t>(z >> (8 * k));
+            }
+            ctrl[i / 4] = c;
+        }
+        return bytes - begin;
+    }
+
+    // Сколько байт данных описывают управляющие байты блока
+    static size_t dataBytesFor(const uint8_t* ctrl, size_t count) {
+        const Tables& t = tables();
+        size_t full = count / 4;
+        size_t total = 0;
+        for (size_t g = 0; g < full; g++)
+            total += t.length[ctrl[g]];
+        for (size_t i = full * 4; i < count; i++)
+            total += ((ctrl[full] >> (2 * (i % 4))) & 3) + 1;
+        return total;
+    }
+
+    // Декодирует блок; data..dataEnd - байты значений блока
+    static void decodeBlock(const uint8_t* ctrl, const uint8_t* data, const uint8_t* dataEnd,
+                            size_t count, int* out) {
+        static const DecodeFn decode = selectDecoder();
+        decode(ctrl, data, dataEnd, count, out);
+    }
+
+private:
+    struct Tables {
+        uint8_t shuffle[256][16];  // маска pshufb: байты значений -> 4 слова
+        uint8_t length[256];       // сумма длин четырёх значений
+    };
+
+    using DecodeFn = void (*)(const uint8_t*, const uint8_t*, const uint8_t*, size_t, int*);
+
+    static const Tables& tables() {
+        static const Tables t = buildTables();
+        return t;
+    }
+
+    static Tables buildTables() {
+        Tables t;
+        for (int c = 0; c < 256; c++) {
+            uint8_t offset = 0;
+            for (int j = 0; j < 4; j++) {
+                int len = ((c >> (2 * j)) & 3) + 1;
+                for (int k = 0; k < 4; k++)
+                    t.shuffle[c][4 * j + k] = k < len ? static_cast<uint8_t>(offset + k) : 0x80;
+                offset = static_cast<uint8_t>(offset + len);
+            }
+            t.length[c] = offset;
+        }
+        return t;
+    }
+
+    // Скалярное декодирование, начиная с элемента from (кратно 4)
+    static void decodeScalarFrom(const uint8_t* ctrl, const uint8_t* data, size_t count,
+                                 int* out, size_t from, uint32_t prev) {
+        for (size_t i = from; i < count; i++) {
+            int len = ((ctrl[i / 4] >> (2 * (i % 4))) & 3) + 1;
+            uint32_t z = 0;
+            for (int k = 0; k < len; k++)
+                z |= static_cast<uint32_t>(data[k]) << (8 * k);
+            data += len;
+            prev += unzigzag(z);
+            out[i] = static_cast<int>(prev);
+        }
+    }
+
+    static void decodeScalar(const uint8_t* ctrl, const uint8_t* data, const uint8_t*,
+                             size_t count, int* out) {
+        decodeScalarFrom(ctrl, data, count, out, 0, 0);
+    }
+
+#ifdef DYNARRAY_HAS_X86_SIMD
+    // Группа из 4 чисел за шаг: pshufb раскладывает байты по словам,
+    // затем zigzag снимается и считается префиксная сумма в регистре.
+    // Последние группы блока (меньше 16 байт до конца) - скалярно.
+    __attribute__((target("ssse3")))
+    static void decodeSsse3(const uint8_t* ctrl, const uint8_t* data, const uint8_t* dataEnd,
+                            size_t count, int* out) {
+        const Tables& t = tables();
+        const __m128i one = _mm_set1_epi32(1);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i prev = zero;
+
+        size_t groups = count / 4;
+        size_t g = 0;
+        for (; g < groups && dataEnd - data >= 16; g++) {
+            uint8_t c = ctrl[g];
+            __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.shuffle[c]));
+            __m128i z = _mm_shuffle_epi8(in, mask);
+            data += t.length[c];
+
+            __m128i x = _mm_xor_si128(_mm_srli_epi32(z, 1), _mm_sub_epi32(zero, _mm_and_si128(z, one)));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+            x = _mm_add_epi32(x, prev);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * g), x);
+            prev = _mm_shuffle_epi32(x, 0xFF);
+        }
+        decodeScalarFrom(ctrl, data, count, out, 4 * g,
+                         static_cast<uint32_t>(_mm_cvtsi128_si32(prev)));
+    }
+#endif
+
+    static DecodeFn selectDecoder() {
+#ifdef DYNARRAY_HAS_X86_SIMD
+        if (__builtin_cpu_supports("ssse3"))
+            return decodeSsse3;
+#endif
+        return decodeScalar;
+    }
+};
+
+// Заголовок формата SVB: 32 байта, все поля little-endian.
+// За ним идут блоки: count (4 байта), dataBytes (4 байта), управляющие
+// байты и байты значений. Разности считаются заново в каждом блоке,
+// поэтому блоки декодируются независимо.
+struct SvbHeader {
+    static constexpr uint32_t kMagic = 0x42565344;  // "DSVB"
+    static constexpr uint16_t kVersion = 1;
+    static constexpr size_t kSize = 32;
+    static constexpr size_t kBlockHeaderSize = 8;
+
+    uint32_t magic = kMagic;
+    uint16_t version = kVersion;
+    uint32_t blockSize = 0;
+    uint64_t count = 0;
+    uint64_t blockCount = 0;
+
+    void encode(char* out) const {
+        std::memset(out, 0, kSize);
+        storeLE(out, magic, 4);
+        storeLE(out + 4, version, 2);
+        storeLE(out + 8, blockSize, 4);
+        storeLE(out + 16, count, 8);
+        storeLE(out + 24, blockCount, 8);
+    }
+
+    static SvbHeader decode(const char* in) {
+        SvbHeader h;
+        h.magic = static_cast<uint32_t>(loadLE(in, 4));
+        h.version = static_cast<uint16_t>(loadLE(in + 4, 2));
+        h.blockSize = static_cast<uint32_t>(loadLE(in + 8, 4));
+        h.count = loadLE(in + 16, 8);
+        h.blockCount = loadLE(in + 24, 8);
+        return h;
+    }
+};
+
+// SVB Class: сжатие разностей (delta + zigzag + stream-vbyte) по блокам
+class ArrVarint : public DynArray {
+public:
+    using DynArray::DynArray;
+
+    static constexpr size_t kBlockSize = 65536;
+
+    // Загрузка: заголовки блоков читаются последовательно (это дёшево),
+    // сами блоки декодируются параллельно сразу в итоговый массив
+    static std::unique_ptr<ArrVarint> load(const std::string& filename) {
+        MappedFile file(filename);
+        const char* base = file.data();
+        const size_t length = file.size();
+
+        if (length < SvbHeader::kSize)
+            throw std::runtime_error("Файл " + filename + " слишком мал для формата SVB");
+        SvbHeader h = SvbHeader::decode(base);
+        if (h.magic != SvbHeader::kMagic || h.version != SvbHeader::kVersion || h.blockSize == 0)
+            throw std::runtime_error("Файл " + filename + " не в формате SVB или неподдерживаемой версии");
+        // Каждое число занимает хотя бы один байт
+        if (h.count > length || h.blockCount != (h.count + h.blockSize - 1) / h.blockSize)
+            throw std::runtime_error("Заголовок файла " + filename + " повреждён");
+
+        const size_t count = static_cast<size_t>(h.count);
+        const size_t blockCount = static_cast<size_t>(h.blockCount);
+        std::vector<size_t> offsets(blockCount);
+        size_t pos = SvbHeader::kSize;
+        for (size_t b = 0; b < blockCount; b++) {
+            if (length - pos < SvbHeader::kBlockHeaderSize)
+                throw std::runtime_error("Файл " + filename + " обрезан");
+            size_t n = static_cast<size_t>(loadLE(base + pos, 4));
+            size_t dataBytes = static_cast<size_t>(loadLE(base + pos + 4, 4));
+            size_t expected = b + 1 < blockCount ? h.blockSize : count - b * h.blockSize;
+            if (n != expected)
+                throw std::runtime_error("Заголовок блока " + std::to_string(b) + " файла " + filename + " повреждён");
+
+            size_t blockBytes = SvbHeader::kBlockHeaderSize + StreamVByte::controlBytes(n) + dataBytes;
+            if (length - pos < blockBytes)
+                throw std::runtime_error("Файл " + filename + " обрезан");
+            offsets[b] = pos;
+            pos += blockBytes;
+        }
+        if (pos != length)
+            throw std::runtime_error("Лишние данные в конце файла " + filename);
+
+        std::unique_ptr<ArrVarint> arr(new ArrVarint(count));
+        int* out = arr->data;
+        parallelFor(blockCount, [&](size_t first, size_t last) {
+            for (size_t b = first; b < last; b++) {
+                const uint8_t* block = reinterpret_cast<const uint8_t*>(base + offsets[b]);
+                size_t n = static_cast<size_t>(loadLE(base + offsets[b], 4));
+                size_t dataBytes = static_cast<size_t>(loadLE(base + offsets[b] + 4, 4));
+                const uint8_t* ctrl = block + SvbHeader::kBlockHeaderSize;
+                const uint8_t* bytes = ctrl + StreamVByte::controlBytes(n);
+
+                if (StreamVByte::dataBytesFor(ctrl, n) != dataBytes)
+                    throw std::runtime_error("Блок " + std::to_string(b) + " файла " + filename + " повреждён");
+                StreamVByte::decodeBlock(ctrl, bytes, bytes + dataBytes, n, out + b * h.blockSize);
+            }
+        }, 1);
+        arr->size = count;
+        return arr;
+    }
+
+protected:
+    // Точный размер: заголовки блоков, управляющие байты и данные
+    size_t fitInBytes(const int* values, size_t count, size_t maxBytes) const override {
+        size_t bytes = SvbHeader::kSize;
+        uint32_t prev = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (i % kBlockSize == 0) {
+                bytes += SvbHeader::kBlockHeaderSize;
+                prev = 0;
+            }
+            if (i % 4 == 0)
+                bytes++;
+            uint32_t v = static_cast<uint32_t>(values[i]);
+            bytes += StreamVByte::byteLength(StreamVByte::zigzag(v - prev));
+            prev = v;
+            if (bytes > maxBytes)
+                return i;
+        }
+        return count;
+    }
+
+    SaveStats writeSnapshot(const int* values, size_t count) const override {
+        std::string filename = makeFileName(".svb");
+        std::ofstream out(filename, std::ios::binary);
+
+        if (!out) {
+            std::cerr << "Ошибка открытия файла!\n";
+            return SaveStats();
+        }
+
+        SvbHeader h;
+        h.blockSize = kBlockSize;
+        h.count = count;
+        h.blockCount = (count + kBlockSize - 1) / kBlockSize;
+        char header[SvbHeader::kSize];
+        h.encode(header);
+        out.write(header, sizeof(header));
+
+        SaveStats stats;
+        stats.bytes = SvbHeader::kSize;
+        std::vector<uint8_t> block(SvbHeader::kBlockHeaderSize +
+                                   StreamVByte::controlBytes(kBlockSize) + 4 * kBlockSize);
+        for (size_t first = 0; first < count; first += kBlockSize) {
+            size_t n = std::min(kBlockSize, count - first);
+            uint8_t* body = block.data() + SvbHeader::kBlockHeaderSize;
+            size_t dataBytes = StreamVByte::encodeBlock(values + first, n, body);
+            storeLE(reinterpret_cast<char*>(block.data()), n, 4);
+            storeLE(reinterpret_cast<char*>(block.data()) + 4, dataBytes, 4);
+
+            size_t blockBytes = SvbHeader::kBlockHeaderSize + StreamVByte::controlBytes(n) + dataBytes;
+            out.write(reinterpret_cast<const char*>(block.data()), blockBytes);
+            stats.bytes += blockBytes;
+        }
+
+        if (!out) {
+            std::cerr << "Ошибка записи файла!\n";
+            return SaveStats();
+        }
+
+        stats.file = filename;
+        stats.elements = count;
+        std::cout << "Файл SVB сохранён: " + filename + "\n";
+        return stats;
+    }
+};
+
+// Запись журнала: заголовок 24 байта (magic, count, firstIndex, checksum,
+// все поля little-endian), за ним count элементов int32 little-endian
+struct JournalRecord {
+    static constexpr uint32_t kMagic = 0x524A4144;  // "DAJR"
+    static constexpr size_t kHeaderSize = 24;
+    static constexpr size_t kMaxCount = 1 << 24;    // элементов в одной записи
+
+    uint32_t magic = kMagic;
+    uint32_t count = 0;
+    uint64_t firstIndex = 0;
+    uint64_t checksum = 0;
+
+    void encode(char* out) const {
+        storeLE(out, magic, 4);
+        storeLE(out + 4, count, 4);
+        storeLE(out + 8, firstIndex, 8);
+        storeLE(out + 16, checksum, 8);
+    }
+
+    static JournalRecord decode(const char* in) {
+        JournalRecord r;
+        r.magic = static_cast<uint32_t>(loadLE(in, 4));
+        r.count = static_cast<uint32_t>(loadLE(in + 4, 4));
+        r.firstIndex = loadLE(in + 8, 8);
+        r.checksum = loadLE(in + 16, 8);
+        return r;
+    }
+};
+
+// Инкрементальное сохранение. Массив помнит, сколько элементов уже
+// сохранено, и save() дописывает в журнал <stem>.journal только новые.
+// compact() переписывает всё в базовый файл <stem>.base.bin (формат BIN)
+// и очищает журнал; это происходит и само, когда журнал вырастает больше
+// базы в compactionRatio раз. load() читает базу и проигрывает журнал.
+// Новый (не загруженный) массив начинает историю заново: при первом
+// сохранении прежние файлы с тем же stem заменяются.
+class ArrJournal : public DynArray {
+public:
+    static constexpr size_t kMinCompactionElements = 1 << 16;
+
+    explicit ArrJournal(const std::string& stem, size_t capacity = 10)
+        : DynArray(capacity), stem(stem) {}
+
+    std::string baseFile() const { return stem + ".base.bin"; }
+    std::string journalFile() const { return stem + ".journal"; }
+
+    void setCompactionRatio(double ratio) { compactionRatio = ratio; }
+
+    // Сохранить новые элементы и переписать всё в базовый файл
+    SaveStats compact() {
+        std::lock_guard<std::mutex> lock(journalMutex);
+        appendLocked(data, size);
+        return compactLocked(data, size);
+    }
+
+    // Загрузка: база, затем записи журнала по порядку. Оборванная или
+    // повреждённая запись в конце журнала (сбой во время save) отбрасывается
+    // вместе со всем, что после неё, и журнал обрезается до целых записей.
+    static std::unique_ptr<ArrJournal> load(const std::string& stem) {
+        std::unique_ptr<ArrJournal> arr(new ArrJournal(stem, 0));
+
+        if (std::filesystem::exists(arr->baseFile())) {
+            std::unique_ptr<ArrBin> base = ArrBin::load(arr->baseFile(), true);
+            arr.reset(new ArrJournal(stem, base->getSize()));
+            arr->append(base->begin(), base->getSize());
+        }
+        arr->baseCount = arr->size;
+
+        if (std::filesystem::exists(arr->journalFile())) {
+            size_t valid = 0;
+            size_t length = 0;
+            {
+                MappedFile journal(arr->journalFile());
+                const char* bytes = journal.data();
+                length = journal.size();
+                std::vector<int> values;
+
+                while (length - valid >= JournalRecord::kHeaderSize) {
+                    JournalRecord r = JournalRecord::decode(bytes + valid);
+                    size_t payload = static_cast<size_t>(r.count) * sizeof(int32_t);
+                    if (r.magic != JournalRecord::kMagic || r.firstIndex > arr->size ||
+                        length - valid - JournalRecord::kHeaderSize < payload)
+                        break;
+
+                    values.resize(r.count);
+                    readInts(bytes + valid + JournalRecord::kHeaderSize, r.count, values.data());
+                    if (fletcher64(values.data(), r.count) != r.checksum)
+                        break;
+
+                    // Записи, уже попавшие в базу (сбой во время compact), пропускаются
+                    size_t skip = arr->size - r.firstIndex;
+                    if (skip < r.count)
+                        arr->append(values.data() + skip, r.count - skip);
+                    valid += JournalRecord::kHeaderSize + payload;
+                }
+            }
+            if (valid < length)
+                std::filesystem::resize_file(arr->journalFile(), valid);
+        }
+
+        arr->journalCount = arr->size - arr->baseCount;
+        arr->savedCount = arr->size;
+        arr->fresh = false;
+        return arr;
+    }
+
+protected:
+    SaveStats writeSnapshot(const int* values, size_t count) const override {
+        std::lock_guard<std::mutex> lock(journalMutex);
+        SaveStats stats = appendLocked(values, count);
+        if (journalCount >= kMinCompactionElements && journalCount > compactionRatio * baseCount)
+            compactLocked(values, count);
+        return stats;
+    }
+
+private:
+    // Дописать в журнал элементы [savedCount, count)
+    SaveStats appendLocked(const int* values, size_t count) const {
+        SaveStats stats;
+        stats.file = journalFile();
+
+        std::ios::openmode mode = std::ios::binary | (fresh ? std::ios::trunc : std::ios::app);
+        if (fresh) {
+            std::error_code ec;
+            std::filesystem::remove(baseFile(), ec);
+        }
+        if (count <= savedCount && !fresh)
+            return stats;
+
+        std::ofstream out(journalFile(), mode);
+        if (!out) {
+            std::cerr << "Ошибка открытия файла!\n";
+            return SaveStats();
+        }
+        fresh = false;
+
+        for (size_t first = savedCount; first < count; first += JournalRecord::kMaxCount) {
+            size_t n = std::min(JournalRecord::kMaxCount, count - first);
+            JournalRecord r;
+            r.count = static_cast<uint32_t>(n);
+            r.firstIndex = first;
+            r.checksum = fletcher64(values + first, n);
+
+            char header[JournalRecord::kHeaderSize];
+            r.encode(header);
+            out.write(header, sizeof(header));
+            writeInts(out, values + first, n);
+            stats.bytes += JournalRecord::kHeaderSize + n * sizeof(int32_t);
+        }
+
+        out.flush();
+        if (!out) {
+            std::cerr << "Ошибка записи файла!\n";
+            return SaveStats();
+        }
+
+        stats.elements = count > savedCount ? count - savedCount : 0;
+        journalCount += stats.elements;
+        savedCount = std::max(savedCount, count);
+        std::cout << "Журнал дополнен: " + stats.file + " (+" + std::to_string(stats.elements) + ")\n";
+        return stats;
+    }
+
+    // Переписать values[0..count) в базовый файл и очистить журнал.
+    // База пишется во временный файл и подменяется переименованием.
+    SaveStats compactLocked(const int* values, size_t count) const {
+        std::string tmp = baseFile() + ".tmp";
+        SaveStats stats;
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            if (!out) {
+                std::cerr << "Ошибка открытия файла!\n";
+                return SaveStats();
+            }
+            stats = ArrBin::writeBinary(out, values, count);
+            out.flush();
+            if (!out) {
+                std::cerr << "Ошибка записи файла!\n";
+                return SaveStats();
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmp, baseFile(), ec);
+        if (ec) {
+            std::cerr << "Ошибка переименования файла: " << ec.message() << "\n";
+            return SaveStats();
+        }
+        std::ofstream(journalFile(), std::ios::binary | std::ios::trunc);
+
+        baseCount = count;
+        journalCount = 0;
+        stats.file = baseFile();
+        std::cout << "Журнал уплотнён: " + stats.file + "\n";
+        return stats;
+    }
+
+    std::string stem;
+    double compactionRatio = 1.0;
+    // Состояние файлов на диске; меняется при сохранении, не затрагивая элементы
+    mutable std::mutex journalMutex;
+    mutable size_t savedCount = 0;    // сколько элементов уже в файлах
+    mutable size_t baseCount = 0;     // из них в базовом файле
+    mutable size_t journalCount = 0;  // и в журнале
+    mutable bool fresh = true;        // файлы ещё не создавались
+};
+
+// Массив для нескольких потоков-производителей поверх любого формата
+// (ArrConcurrent<ArrCSV> и т.п.). Элементы лежат в сегментах, каждый вдвое
+// больше предыдущего; сегменты никогда не перемещаются. push_back занимает
+// слот через fetch_add и после записи отмечает его в битовой карте
+// готовности - без блокировок и ожидания других потоков. getSize()
+// возвращает длину префикса, где все слоты уже записаны: такие элементы
+// можно читать из любого потока.
+// Это не DynArray: элементы не лежат одним буфером, поэтому массовые
+// операции DynArray к нему неприменимы. Format используется только для
+// записи файлов (аргументы конструктора передаются ему).
+template<typename Format>
+class ArrConcurrent {
+public:
+    template<typename... Args>
+    explicit ArrConcurrent(Args&&... args) : writer(std::forward<Args>(args)...) {}
+
+    ~ArrConcurrent() {
+        for (auto& s : segments)
+            delete s.load(std::memory_order_relaxed);
+    }
+
+    ArrConcurrent(const ArrConcurrent&) = delete;
+    ArrConcurrent& operator=(const ArrConcurrent&) = delete;
+
+    // Добавление из любого потока; возвращает индекс элемента
+    size_t push_back(int value) {
+        size_t index = claimed.fetch_add(1, std::memory_order_relaxed);
+        size_t k = segmentOf(index);
+        Segment* s = segments[k].load(std::memory_order_acquire);
+        if (!s)
+            s = allocateSegment(k);
+
+        size_t offset = index - segmentStart(k);
+        s->values[offset] = value;
+        s->ready[offset / 64].fetch_or(uint64_t(1) << (offset % 64), std::memory_order_release);
+        return index;
+    }
+
+    size_t getSize() const {
+        size_t from = published.load(std::memory_order_acquire);
+        size_t ready = scanReady(from, claimed.load(std::memory_order_acquire));
+        // Запоминаем найденную длину, чтобы следующий вызов не сканировал заново
+        while (from < ready &&
+               !published.compare_exchange_weak(from, ready, std::memory_order_acq_rel)) {
+        }
+        return std::max(from, ready);
+    }
+
+    // Чтение опубликованного элемента (i < getSize())
+    int operator[](size_t i) const {
+        size_t k = segmentOf(i);
+        return segments[k].load(std::memory_order_acquire)->values[i - segmentStart(k)];
+    }
+
+    SaveStats save() {
+        size_t count = getSize();
+        std::vector<int> snapshot(count);
+        copyTo(snapshot.data(), count);
+        return writer.timedSnapshot(snapshot.data(), count);
+    }
+
+    // Опубликованные элементы не меняются и не перемещаются, поэтому
+    // снимок - это просто их количество; копирование идёт в фоне
+    std::future<SaveStats> saveAsync() {
+        size_t count = getSize();
+        return std::async(std::launch::async, [this, count]() {
+            std::vector<int> snapshot(count);
+            copyTo(snapshot.data(), count);
+            return writer.timedSnapshot(snapshot.data(), count);
+        });
+    }
+
+private:
+    // Доступ к записи файлов формата; собственные элементы Format не используются
+    struct Writer : Format {
+        using Format::Format;
+        using Format::timedSnapshot;
+    };
+
+    static constexpr size_t kFirstSegmentBits = 10;  // первый сегмент - 1024 элемента
+    static constexpr size_t kMaxSegments = 40;
+
+    struct Segment {
+        explicit Segment(size_t length)
+            : values(new int[length]), ready(new std::atomic<uint64_t>[length / 64]()) {}
+
+        std::unique_ptr<int[]> values;
+        std::unique_ptr<std::atomic<uint64_t>[]> ready;  // бит на слот: значение записано
+    };
+
+    static size_t log2Floor(unsigned long long x) {
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(x);
+#else
+        size_t r = 0;
+        while (x >>= 1)
+            r++;
+        return r;
+#endif
+    }
+
+    static size_t trailingZeros(uint64_t x) {
+#if defined(__GNUC__)
+        return __builtin_ctzll(x);
+#else
+        size_t r = 0;
+        while (!(x & 1)) {
+            x >>= 1;
+            r++;
+        }
+        return r;
+#endif
+    }
+
+    // Сегмент k начинается с S0 * (2^k - 1) и содержит S0 * 2^k элементов
+    static size_t segmentOf(size_t index) {
+        return log2Floor((index >> kFirstSegmentBits) + 1);
+    }
+
+    static size_t segmentStart(size_t k) {
+        return ((size_t(1) << k) - 1) << kFirstSegmentBits;
+    }
+
+    static size_t segmentLength(size_t k) {
+        return size_t(1) << (k + kFirstSegmentBits);
+    }
+
+    // Сегмент выделяет первый, кому он понадобился; проигравший гонку
+    // освобождает свой экземпляр и берёт опубликованный
+    Segment* allocateSegment(size_t k) {
+        if (k >= kMaxSegments)
+            throw std::length_error("ArrConcurrent: превышена максимальная длина");
+        Segment* fresh = new Segment(segmentLength(k));
+        Segment* expected = nullptr;
+        if (!segments[k].compare_exchange_strong(expected, fresh, std::memory_order_acq_rel,
+                                                 std::memory_order_acquire)) {
+            delete fresh;
+            return expected;
+        }
+        return fresh;
+    }
+
+    // Первый незаписанный слот в [from, limit), по 64 слота за шаг
+    size_t scanReady(size_t from, size_t limit) const {
+        size_t i = from;
+        while (i < limit) {
+            size_t k = segmentOf(i);
+            Segment* s = segments[k].load(std::memory_order_acquire);
+            if (!s)
+                break;
+            size_t offset = i - segmentStart(k);
+            uint64_t word = s->ready[offset / 64].load(std::memory_order_acquire) >> (offset % 64);
+            uint64_t missing = ~word;
+            size_t run = missing ? trailingZeros(missing) : 64;
+            i += run;
+            if (run < 64 - offset % 64)
+                break;
+        }
+        return std::min(i, limit);
+    }
+
+    void copyTo(int* out, size_t count) const {
+        for (size_t k = 0; k < kMaxSegments && segmentStart(k) < count; k++) {
+            size_t n = std::min(segmentLength(k), count - segmentStart(k));
+            std::memcpy(out + segmentStart(k), segments[k].load(std::memory_order_acquire)->values.get(),
+                        n * sizeof(int));
+        }
+    }
+
+    Writer writer;
+    std::atomic<Segment*> segments[kMaxSegments] = {};
+    std::atomic<size_t> claimed{0};            // выданные слоты
+    mutable std::atomic<size_t> published{0};  // известная длина готового префикса
+};
+
+// Сброс файла на диск (fsync). Без POSIX ничего не делает.
+inline bool syncFile(const std::string& filename) {
+#ifdef DYNARRAY_HAS_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#else
+    (void)filename;
+    return true;
+#endif
+}
+
+// Сброс каталога файла, чтобы после сбоя сохранилась и запись о нём
+inline bool syncDirectoryOf(const std::string& filename) {
+    std::string dir = std::filesystem::path(filename).parent_path().string();
+    return syncFile(dir.empty() ? "." : dir);
+}
+
+// Когда сегменты ArrRolling сбрасываются на диск.
+// ArrMapped этой политики не имеет: на диске гарантировано состояние
+// последнего flush(). Если процесс или система упали раньше, заголовок
+// хранит число элементов этого flush(), и при открытии действуют только
+// они: добавленное позже теряется, а изменения на месте в этих элементах
+// могли частично попасть в файл (контрольная сумма их выявит)
+class Durability {
+public:
+    enum class Mode { None, EverySegment, Batched };
+
+    // fsync не вызывается, запись остаётся на усмотрение ОС
+    static Durability none() { return Durability(Mode::None, 0, 0); }
+    // Каждый сегмент сбрасывается сразу после записи
+    static Durability everySegment() { return Durability(Mode::EverySegment, 1, 0); }
+    // Сегменты копятся и сбрасываются группой, когда их набралось
+    // segments штук или bytes байт (0 - без этого ограничения)
+    static Durability batched(size_t segments, size_t bytes) {
+        return Durability(Mode::Batched, segments, bytes);
+    }
+
+    Mode mode;
+    size_t segments;
+    size_t bytes;
+
+private:
+    Durability(Mode mode, size_t segments, size_t bytes)
+        : mode(mode), segments(segments), bytes(bytes) {}
+};
+
+// Сохранение поверх любого формата (ArrRolling<ArrCSV> и т.п.), разбитое
+// на сегменты: новый файл начинается, когда текущий достиг maxBytes байт
+// или maxElements элементов (0 - без ограничения). Каждый сегмент - целый
+// файл формата с частью элементов по порядку; их список - в SaveStats::segments.
+// fsync сегментов группируется по политике Durability; то, что ещё не
+// сброшено, сбрасывает sync() и деструктор.
+template<typename Format>
+class ArrRolling : public Format {
+public:
+    using Format::Format;
+
+    ~ArrRolling() override {
+        sync();
+    }
+
+    void setSegmentLimits(size_t maxBytes, size_t maxElements) {
+        std::lock_guard<std::mutex> lock(rollMutex);
+        this->maxBytes = maxBytes;
+        this->maxElements = maxElements;
+    }
+
+    void setDurability(Durability policy) {
+        std::lock_guard<std::mutex> lock(rollMutex);
+        durability = policy;
+    }
+
+    // Сброс на диск всех записанных, но ещё не сброшенных сегментов
+    bool sync() {
+        std::lock_guard<std::mutex> lock(rollMutex);
+        return syncPending();
+    }
+
+protected:
+    SaveStats writeSnapshot(const int* values, size_t count) const override {
+        std::lock_guard<std::mutex> lock(rollMutex);
+        SaveStats total;
+        size_t first = 0;
+        do {
+            size_t n = count - first;
+            if (maxElements > 0)
+                n = std::min(n, maxElements);
+            if (maxBytes > 0 && n > 0)
+                n = std::max<size_t>(1, this->fitInBytes(values + first, n, maxBytes));
+
+            SaveStats part = Format::writeSnapshot(values + first, n);
+            if (part.file.empty())
+                return SaveStats();
+            if (total.file.empty())
+                total.file = part.file;
+            total.bytes += part.bytes;
+            total.elements += part.elements;
+            total.segments.push_back(part.file);
+
+            if (durability.mode != Durability::Mode::None) {
+                pending.push_back(part.file);
+                pendingBytes += part.bytes;
+            }
+            bool full = durability.mode == Durability::Mode::EverySegment ||
+                        (durability.segments > 0 && pending.size() >= durability.segments) ||
+                        (durability.bytes > 0 && pendingBytes >= durability.bytes);
+            if (durability.mode != Durability::Mode::None && full && !syncPending())
+                return SaveStats();
+            first += n;
+        } while (first < count);
+        return total;
+    }
+
+private:
+    // Файлы сбрасываются по одному, каталог - один раз на группу
+    bool syncPending() const {
+        if (pending.empty())
+            return true;
+        bool ok = true;
+        for (const std::string& file : pending)
+            ok = syncFile(file) && ok;
+        ok = syncDirectoryOf(pending.back()) && ok;
+        pending.clear();
+        pendingBytes = 0;
+        if (!ok)
+            std::cerr << "Ошибка сброса файлов на диск!\n";
+        return ok;
+    }
+
+    mutable std::mutex rollMutex;
+    size_t maxBytes = 0;
+    size_t maxElements = 0;
+    Durability durability = Durability::none();
+    mutable std::vector<std::string> pending;  // записаны, но не сброшены
+    mutable size_t pendingBytes = 0;
+};
+
+// MAIN
+int main() {
+    ArrTxt arrTxt;
     ArrCSV arrCsv;
+    ArrBin arrBin;
+    ArrVarint arrSvb;
 
     // Добавим данные
     for (int i = 1; i <= 10; i++) {
         arrTxt.push_back(i * 2);
         arrCsv.push_back(i * 3);
+        arrBin.push_back(i * 4);
+        arrSvb.push_back(i * 5);
     }
 
     // Вызов виртуальных функций (полиморфизм)
-    DynArray* arrays[2];
+    DynArray* arrays[4];
     arrays[0] = &arrTxt;
     arrays[1] = &arrCsv;
+    arrays[2] = &arrBin;
+    arrays[3] = &arrSvb;
+
+    // Сохранение в фоне: пока файлы пишутся, массивы продолжают расти
+    std::future<SaveStats> pending[4];
+    for (int i = 0; i < 4; i++) {
+        pending[i] = arrays[i]->saveAsync();
+    }
+    for (int i = 11; i <= 20; i++) {
+        arrTxt.push_back(i * 2);
+    }
+
+    SaveStats stats[4];
+    for (int i = 0; i < 4; i++) {
+        stats[i] = pending[i].get();
+    }
+
+    // Загрузка двоичного файла обратно (без копирования)
+    try {
+        std::unique_ptr<ArrBin> loaded = ArrBin::load(stats[2].file, true);
+        std::cout << "Загружено из BIN: " << loaded->getSize() << " элементов, последний "
+                  << (*loaded)[loaded->getSize() - 1] << "\n";
+        std::unique_ptr<ArrCSV> csv = ArrCSV::load(stats[1].file);
+        std::cout << "Загружено из CSV: " << csv->getSize() << " элементов, последний "
+                  << (*csv)[csv->getSize() - 1] << "\n";
+        std::unique_ptr<ArrVarint> svb = ArrVarint::load(stats[3].file);
+        std::cout << "Загружено из SVB: " << svb->getSize() << " элементов, последний "
+                  << (*svb)[svb->getSize() - 1] << " (" << stats[3].bytes << " байт)\n";
+
+        // Массовые операции; loaded смотрит в отображённый файл, поэтому
+        // transform сначала переносит элементы в собственный буфер
+        loaded->transform([](int v) { return 100 - v; });
+        loaded->sort();
+        std::cout << "BIN после transform и sort: " << (*loaded)[0] << ".." << (*loaded)[loaded->getSize() - 1]
+                  << ", сумма " << loaded->reduce(0LL, std::plus<long long>())
+                  << ", кратных 12: " << loaded->countIf([](int v) { return v % 12 == 0; })
+                  << ", первый > 50 на позиции " << loaded->find([](int v) { return v > 50; }) << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Ошибка загрузки: " << e.what() << "\n";
+    }
+
+    // Инкрементальное сохранение: save() дописывает только новые элементы
+    ArrJournal journal("journal");
+    for (int i = 1; i <= 10; i++) {
+        journal.push_back(i * 6);
+    }
+    journal.save();
+    for (int i = 11; i <= 15; i++) {
+        journal.push_back(i * 6);
+    }
+    journal.save();
+    journal.compact();
+    journal.push_back(96);
+    journal.save();
+
+    try {
+        std::unique_ptr<ArrJournal> restored = ArrJournal::load("journal");
+        std::cout << "Восстановлено из журнала: " << restored->getSize() << " элементов, последний "
+                  << (*restored)[restored->getSize() - 1] << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Ошибка загрузки: " << e.what() << "\n";
+    }
 
-    for (int i = 0; i < 2; i++) {
-        arrays[i]->save();
+    // Несколько потоков добавляют элементы в один массив без блокировок
+    ArrConcurrent<ArrCSV> shared;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; t++) {
+        producers.emplace_back([&shared, t]() {
+            for (int i = 1; i <= 25; i++)
+                shared.push_back(t * 100 + i);
+        });
     }
+    for (auto& p : producers) {
+        p.join();
+    }
+    shared.save();
+    std::cout << "Добавлено из 4 потоков: " << shared.getSize() << " элементов\n";
+
+    // Размер известен заранее: память из арены, ёмкость ровно по размеру
+    ArenaAllocator arena;
+    ArrBin exact(0, arena);
+    exact.setGrowthPolicy(GrowthPolicy::exact());
+    exact.reserve(shared.getSize());
+    for (size_t i = 0; i < shared.getSize(); i++) {
+        exact.push_back(shared[i]);
+    }
+    ArrBin moved(std::move(exact));
+    std::cout << "Перенесено без копирования: " << moved.getSize() << " элементов, ёмкость "
+              << moved.getCapacity() << "\n";
+
+    // Частые контрольные точки: сегменты до 64 байт, fsync группами по 4
+    ArrRolling<ArrCSV> rolling;
+    rolling.setSegmentLimits(64, 0);
+    rolling.setDurability(Durability::batched(4, 0));
+    for (int i = 1; i <= 40; i++) {
+        rolling.push_back(i * 7);
+    }
+    SaveStats rolled = rolling.save();
+    std::cout << "Сохранено сегментов: " << rolled.segments.size() << ", всего байт: "
+              << rolled.bytes << "\n";
+
+    // Массив прямо в файле: push_back пишет в отображение, повторное
+    // открытие не читает элементы заранее
+    try {
+        {
+            std::unique_ptr<ArrMapped> mapped = ArrMapped::create("mapped.bin");
+            for (int i = 1; i <= 1000; i++)
+                mapped->push_back(i * 9);
+            mapped->transform([](int v) { return v % 1000; });
+        }
+        std::unique_ptr<ArrMapped> reopened =
+            ArrMapped::open("mapped.bin", ArrMapped::Mode::ReadOnly, MappedFile::Advice::Sequential);
+        std::cout << "Отображено из файла: " << reopened->getSize() << " элементов, последний "
+                  << (*reopened)[reopened->getSize() - 1] << ", максимум " << reopened->max() << "\n";
+        ArrBin::load("mapped.bin", true);
+        std::filesystem::remove("mapped.bin");
+    } catch (const std::exception& e) {
+        std::cerr << "Ошибка отображения: " << e.what() << "\n";
+    }
+
+#ifdef ARRAY_INSTRUMENTATION
+    std::cout << Instrumentation::snapshot().toText();
+#endif
 
     return 0;
 }
\ No newline at end of file
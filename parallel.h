@@ -0,0 +1,497 @@
+// Параллельные алгоритмы над непрерывными массивами (pz6, pz9, main):
+// parallelFor, parallelTransform, parallelReduce / parallelMapReduce,
+// parallelSort, parallelMinMax, parallelCountIf, parallelFind.
+//
+// Работа делится на куски по grain элементов (0 - значение по умолчанию).
+// Куски выполняет ThreadPool с перехватом работы: у каждого участника свой
+// диапазон номеров кусков, он берёт их с начала, а освободившийся поток
+// забирает половину чужого диапазона с конца. Вызывающий поток работает
+// наравне с пулом. Один кусок, пул из одного потока или вызов изнутри
+// задачи пула - всё выполняется в вызывающем потоке, пул даже не создаётся.
+//
+// Границы кусков зависят только от n и grain, а частичные результаты
+// складываются в порядке кусков, поэтому parallelReduce для float/double
+// даёт один и тот же результат при любом числе потоков.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class ThreadPool {
+public:
+    // threads - число участников вместе с вызывающим потоком
+    explicit ThreadPool(size_t threads) {
+        for (size_t i = 1; i < threads; i++)
+            workers.emplace_back([this, i]() { workerLoop(i); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (std::thread& t : workers)
+            t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Общий пул на все ядра; создаётся при первой параллельной операции
+    static ThreadPool& shared() {
+        static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+
+    size_t getThreads() const { return workers.size() + 1; }
+
+    // body(task) для каждого task из [0, tasks). Исключение из задачи
+    // отменяет ещё не начатые задачи с большими номерами; вызывающему
+    // пробрасывается исключение задачи с наименьшим номером - то же, что
+    // дал бы последовательный цикл. Пока пул занят другим вызовом, задачи
+    // выполняются в вызывающем потоке.
+    template<typename Body>
+    void run(size_t tasks, Body&& body) {
+        std::unique_lock<std::mutex> submit(submitMutex, std::defer_lock);
+        if (tasks < 2 || workers.empty() || insideTask() || !submit.try_lock()) {
+            for (size_t t = 0; t < tasks; t++)
+                body(t);
+            return;
+        }
+        if (tasks > UINT32_MAX)
+            throw std::length_error("Слишком много задач для пула потоков");
+        using Fn = std::remove_reference_t<Body>;
+        Job job(tasks, getThreads(), [](const void* context, size_t task) {
+            (*static_cast<Fn*>(const_cast<void*>(context)))(task);
+        }, &body);
+        execute(job);
+    }
+
+private:
+    // Диапазон номеров задач [lo, hi) одного участника в одном слове:
+    // владелец и воры меняют его только через compare_exchange
+    struct alignas(64) Range {
+        std::atomic<uint64_t> bounds{0};
+    };
+
+    struct Job {
+        void (*call)(const void*, size_t);
+        const void* context;
+        size_t participants;
+        std::unique_ptr<Range[]> ranges;
+        std::atomic<size_t> pending;  // задачи, которые ещё не завершились
+        std::atomic<size_t> active{0};  // рабочие потоки внутри work()
+        std::atomic<size_t> failedTask{SIZE_MAX};  // наименьшая упавшая задача
+        std::mutex errorMutex;
+        std::exception_ptr error;
+
+        Job(size_t tasks, size_t participants, void (*call)(const void*, size_t), const void* context)
+            : call(call), context(context), participants(participants),
+              ranges(new Range[participants]), pending(tasks) {
+            for (size_t p = 0; p < participants; p++)
+                ranges[p].bounds.store(pack(tasks * p / participants, tasks * (p + 1) / participants),
+                                       std::memory_order_relaxed);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;  // один параллельный вызов за раз
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    Job* current = nullptr;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    static bool& insideTask() {
+        thread_local bool inside = false;
+        return inside;
+    }
+
+    static uint64_t pack(uint64_t lo, uint64_t hi) { return lo << 32 | hi; }
+
+    // Следующая задача из своего диапазона (с начала)
+    static bool take(Range& range, size_t& task) {
+        uint64_t b = range.bounds.load(std::memory_order_acquire);
+        for (;;) {
+            uint64_t lo = b >> 32, hi = b & UINT32_MAX;
+            if (lo >= hi)
+                return false;
+            if (range.bounds.compare_exchange_weak(b, pack(lo + 1, hi), std::memory_order_acq_rel)) {
+                task = lo;
+                return true;
+            }
+        }
+    }
+
+    // Забирает у другого участника половину (с конца) его диапазона в свой
+    static bool steal(Job& job, size_t self) {
+        for (size_t k = 1; k < job.participants; k++) {
+            Range& victim = job.ranges[(self + k) % job.participants];
+            uint64_t b = victim.bounds.load(std::memory_order_acquire);
+            for (;;) {
+                uint64_t lo = b >> 32, hi = b & UINT32_MAX;
+                if (lo >= hi)
+                    break;
+                uint64_t mid = hi - (hi - lo + 1) / 2;
+                if (victim.bounds.compare_exchange_weak(b, pack(lo, mid), std::memory_order_acq_rel)) {
+                    job.ranges[self].bounds.store(pack(mid, hi), std::memory_order_release);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static void work(Job& job, size_t self) {
+        for (;;) {
+            size_t task;
+            if (take(job.ranges[self], task)) {
+                if (task < job.failedTask.load(std::memory_order_relaxed)) {
+                    try {
+                        job.call(job.context, task);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(job.errorMutex);
+                        if (task < job.failedTask.load(std::memory_order_relaxed)) {
+                            job.error = std::current_exception();
+                            job.failedTask.store(task, std::memory_order_relaxed);
+                        }
+                    }
+                }
+                job.pending.fetch_sub(1, std::memory_order_acq_rel);
+            } else if (!steal(job, self)) {
+                return;
+            }
+        }
+    }
+
+    void execute(Job& job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = &job;
+            generation++;
+        }
+        wakeup.notify_all();
+
+        insideTask() = true;
+        work(job, 0);
+        insideTask() = false;
+
+        // Задачи, взятые другими потоками, могут ещё выполняться
+        while (job.pending.load(std::memory_order_acquire) != 0)
+            std::this_thread::yield();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = nullptr;
+        }
+        while (job.active.load(std::memory_order_acquire) != 0)
+            std::this_thread::yield();
+
+        if (job.error)
+            std::rethrow_exception(job.error);
+    }
+
+    void workerLoop(size_t self) {
+        insideTask() = true;
+        uint64_t seen = 0;
+        for (;;) {
+            Job* job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [&]() { return stopping || (current && generation != seen); });
+                if (stopping)
+                    return;
+                seen = generation;
+                job = current;
+                job->active.fetch_add(1, std::memory_order_relaxed);
+            }
+            work(*job, self);
+            job->active.fetch_sub(1, std::memory_order_release);
+        }
+    }
+};
+
+// Куски по умолчанию: достаточно крупные, чтобы накладные расходы на
+// задачу (десятки наносекунд) терялись на фоне самого прохода
+constexpr size_t kParallelGrain = size_t(1) << 14;
+constexpr size_t kParallelSortGrain = size_t(1) << 16;
+
+// body(chunk, begin, end) для кусков [begin, end) по grain элементов
+template<typename Body>
+void parallelChunks(size_t n, size_t grain, ThreadPool* pool, Body&& body) {
+    if (grain == 0)
+        grain = kParallelGrain;
+    size_t chunks = n / grain + (n % grain != 0);
+    if (chunks <= 1) {
+        if (n > 0)
+            body(size_t(0), size_t(0), n);
+        return;
+    }
+    (pool ? *pool : ThreadPool::shared()).run(chunks, [&](size_t c) {
+        size_t begin = c * grain;
+        body(c, begin, std::min(n, begin + grain));
+    });
+}
+
+// body(begin, end) для кусков [0, n)
+template<typename Body>
+void parallelFor(size_t n, Body&& body, size_t grain = 0, ThreadPool* pool = nullptr) {
+    parallelChunks(n, grain, pool, [&](size_t, size_t begin, size_t end) { body(begin, end); });
+}
+
+// out[i] = fn(in[i]); in и out могут совпадать
+template<typename T, typename U, typename Fn>
+void parallelTransform(const T* in, size_t n, U* out, Fn&& fn, size_t grain = 0,
+                       ThreadPool* pool = nullptr) {
+    parallelFor(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            out[i] = fn(in[i]);
+    }, grain, pool);
+}
+
+// combine(..., map(begin, end)) по кускам слева направо, начиная с identity
+template<typename R, typename Map, typename Combine>
+R parallelMapReduce(size_t n, R identity, Map&& map, Combine&& combine, size_t grain = 0,
+                    ThreadPool* pool = nullptr) {
+    if (grain == 0)
+        grain = kParallelGrain;
+    size_t chunks = n / grain + (n % grain != 0);
+    if (chunks <= 1)
+        return n > 0 ? combine(identity, map(size_t(0), n)) : identity;
+    std::vector<R> partial(chunks, identity);
+    parallelChunks(n, grain, pool, [&](size_t c, size_t begin, size_t end) {
+        partial[c] = map(begin, end);
+    });
+    R total = identity;
+    for (const R& p : partial)
+        total = combine(total, p);
+    return total;
+}
+
+// Свёртка values[0..n) операцией op (ассоциативной, identity - её нейтральный
+// элемент). Порядок сложения фиксирован кусками, а не потоками
+template<typename T, typename R, typename Op>
+R parallelReduce(const T* values, size_t n, R identity, Op&& op, size_t grain = 0,
+                 ThreadPool* pool = nullptr) {
+    return parallelMapReduce(n, identity, [&](size_t begin, size_t end) {
+        R acc = identity;
+        for (size_t i = begin; i < end; i++)
+            acc = op(acc, values[i]);
+        return acc;
+    }, op, grain, pool);
+}
+
+template<typename T, typename Pred>
+size_t parallelCountIf(const T* values, size_t n, Pred&& pred, size_t grain = 0,
+                       ThreadPool* pool = nullptr) {
+    return parallelMapReduce(n, size_t(0), [&](size_t begin, size_t end) {
+        size_t count = 0;
+        for (size_t i = begin; i < end; i++)
+            count += pred(values[i]) ? 1 : 0;
+        return count;
+    }, std::plus<size_t>(), grain, pool);
+}
+
+// Индекс первого элемента, для которого pred истинен, или n. Куски правее
+// уже найденного совпадения не просматриваются
+template<typename T, typename Pred>
+size_t parallelFind(const T* values, size_t n, Pred&& pred, size_t grain = 0,
+                    ThreadPool* pool = nullptr) {
+    std::atomic<size_t> found(n);
+    parallelFor(n, [&](size_t begin, size_t end) {
+        if (begin >= found.load(std::memory_order_relaxed))
+            return;
+        for (size_t i = begin; i < end; i++) {
+            if (pred(values[i])) {
+                size_t best = found.load(std::memory_order_relaxed);
+                while (i < best && !found.compare_exchange_weak(best, i, std::memory_order_relaxed)) {}
+                return;
+            }
+        }
+    }, grain, pool);
+    return found.load(std::memory_order_relaxed);
+}
+
+// Индексы первого минимального и первого максимального элемента
+template<typename T>
+std::pair<size_t, size_t> parallelMinMax(const T* values, size_t n, size_t grain = 0,
+                                         ThreadPool* pool = nullptr) {
+    if (n == 0)
+        throw std::out_of_range("Массив пуст");
+    using Extremes = std::pair<size_t, size_t>;
+    return parallelMapReduce(n, Extremes(n, n), [&](size_t begin, size_t end) {
+        Extremes e(begin, begin);
+        for (size_t i = begin + 1; i < end; i++) {
+            if (values[i] < values[e.first])
+                e.first = i;
+            if (values[e.second] < values[i])
+                e.second = i;
+        }
+        return e;
+    }, [&](Extremes a, Extremes b) {
+        if (a.first == n)
+            return b;
+        return Extremes(values[b.first] < values[a.first] ? b.first : a.first,
+                        values[a.second] < values[b.second] ? b.second : a.second);
+    }, grain, pool);
+}
+
+// Сколько элементов из a[0..na) входит в первые k элементов устойчивого
+// слияния a и b (при равенстве раньше идёт a)
+template<typename T>
+size_t mergeSplit(const T* a, size_t na, const T* b, size_t nb, size_t k) {
+    size_t lo = k > nb ? k - nb : 0, hi = std::min(k, na);
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (b[k - i - 1] < a[i])
+            hi = i;
+        else
+            lo = i + 1;
+    }
+    return lo;
+}
+
+// Сортировка слиянием: куски сортируются std::sort, затем попарно
+// сливаются; каждое слияние делится на части по grain элементов результата,
+// так что параллельны и последние проходы
+template<typename T>
+void parallelMergeSort(T* values, size_t n, size_t grain, ThreadPool* pool) {
+    parallelChunks(n, grain, pool, [&](size_t, size_t begin, size_t end) {
+        std::sort(values + begin, values + end);
+    });
+    if (n <= grain)
+        return;
+
+    std::vector<T> scratch(n);
+    T* src = values;
+    T* dst = scratch.data();
+    for (size_t width = grain; width < n; width *= 2) {
+        // Задача: часть [first, last) результата слияния пары, начинающейся
+        // в lo; split - сколько элементов левой половины идёт до first.
+        // Разбиения считаются до слияния: слияние перемещает элементы, и
+        // соседние задачи уже не смогли бы их сравнивать
+        struct Part { size_t lo, first, last, split; };
+        std::vector<Part> parts;
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t length = std::min(n - lo, 2 * width);
+            for (size_t first = 0; first < length; first += grain)
+                parts.push_back({lo, first, std::min(length, first + grain), 0});
+        }
+        auto halves = [&](const Part& part, T*& a, size_t& na, T*& b, size_t& nb) {
+            size_t mid = std::min(n, part.lo + width);
+            a = src + part.lo;
+            b = src + mid;
+            na = mid - part.lo;
+            nb = std::min(n, part.lo + 2 * width) - mid;
+        };
+        parallelFor(parts.size(), [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; p++) {
+                T* a;
+                T* b;
+                size_t na, nb;
+                halves(parts[p], a, na, b, nb);
+                parts[p].split = mergeSplit(a, na, b, nb, parts[p].first);
+            }
+        }, 64, pool);
+        parallelFor(parts.size(), [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; p++) {
+                const Part& part = parts[p];
+                T* a;
+                T* b;
+                size_t na, nb;
+                halves(part, a, na, b, nb);
+                size_t i0 = part.split;
+                size_t i1 = (p + 1 < parts.size() && parts[p + 1].lo == part.lo) ? parts[p + 1].split : na;
+                std::merge(std::make_move_iterator(a + i0), std::make_move_iterator(a + i1),
+                           std::make_move_iterator(b + (part.first - i0)),
+                           std::make_move_iterator(b + (part.last - i1)),
+                           dst + part.lo + part.first, [](const T& x, const T& y) { return x < y; });
+            }
+        }, 1, pool);
+        std::swap(src, dst);
+    }
+    if (src != values) {
+        parallelFor(n, [&](size_t begin, size_t end) {
+            std::move(src + begin, src + end, values + begin);
+        }, grain, pool);
+    }
+}
+
+// Поразрядная (LSD, по байту) устойчивая сортировка целых: на каждом
+// проходе куски параллельно считают гистограммы цифр, затем параллельно
+// раскладывают элементы по смещениям "цифра, потом кусок". Проход, где у
+// всех элементов одна и та же цифра, пропускается
+template<typename T>
+void parallelRadixSort(T* values, size_t n, size_t grain, ThreadPool* pool) {
+    using Key = std::make_unsigned_t<T>;
+    constexpr Key kFlip = std::is_signed_v<T> ? Key(Key(1) << (sizeof(T) * 8 - 1)) : Key(0);
+    size_t chunks = n / grain + (n % grain != 0);
+    std::vector<std::array<size_t, 256>> counts(chunks);
+    std::unique_ptr<T[]> scratch(new T[n]);
+    T* src = values;
+    T* dst = scratch.get();
+
+    for (unsigned shift = 0; shift < sizeof(T) * 8; shift += 8) {
+        auto digit = [shift](T v) { return static_cast<size_t>((Key(v) ^ kFlip) >> shift & 0xFF); };
+        parallelChunks(n, grain, pool, [&](size_t c, size_t begin, size_t end) {
+            std::array<size_t, 256>& h = counts[c];
+            h.fill(0);
+            for (size_t i = begin; i < end; i++)
+                h[digit(src[i])]++;
+        });
+        size_t offset = 0;
+        bool trivial = false;
+        for (size_t d = 0; d < 256 && !trivial; d++) {
+            size_t start = offset;
+            for (size_t c = 0; c < chunks; c++) {
+                size_t k = counts[c][d];
+                counts[c][d] = offset;
+                offset += k;
+            }
+            trivial = offset - start == n;
+        }
+        if (trivial)
+            continue;
+        parallelChunks(n, grain, pool, [&](size_t c, size_t begin, size_t end) {
+            std::array<size_t, 256>& pos = counts[c];
+            for (size_t i = begin; i < end; i++)
+                dst[pos[digit(src[i])]++] = src[i];
+        });
+        std::swap(src, dst);
+    }
+    if (src != values) {
+        parallelFor(n, [&](size_t begin, size_t end) {
+            std::memcpy(values + begin, src + begin, (end - begin) * sizeof(T));
+        }, grain, pool);
+    }
+}
+
+// Сортировка по возрастанию: целые - поразрядная, остальное - слиянием.
+// Короче двух кусков - std::sort в вызывающем потоке
+template<typename T>
+void parallelSort(T* values, size_t n, size_t grain = 0, ThreadPool* pool = nullptr) {
+    if (grain == 0)
+        grain = kParallelSortGrain;
+    if (n < 2 * grain) {
+        std::sort(values, values + n);
+        return;
+    }
+    if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>)
+        parallelRadixSort(values, n, grain, pool);
+    else
+        parallelMergeSort(values, n, grain, pool);
+}
@@ -1,20 +1,258 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <functional>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PZ6_HAS_X86_SIMD 1
+#endif
+
+#include "instrumentation.h"
+#include "parallel.h"
+
+// Пакетная проверка и упаковка: src[0..count) из int в int8_t.
+// Возвращает, сколько первых элементов записано; меньше count - значит
+// src[результат] вне [-100, 100]. Блоки по 64 значения сначала проверяются
+// целиком, и только блок с ошибкой просматривается поэлементно.
+const int kPackBlock = 64;
+
+inline bool inRange(int value) {
+    return value >= -100 && value <= 100;
+}
+
+// Поэлементно: хвосты и блоки с ошибкой
+inline int packCheckedScalar(const int* src, int8_t* dst, int count) {
+    for (int i = 0; i < count; i++) {
+        if (!inRange(src[i])) {
+            return i;
+        }
+        dst[i] = static_cast<int8_t>(src[i]);
+    }
+    return count;
+}
+
+#ifdef PZ6_HAS_X86_SIMD
+// SSE2 (есть на любом x86-64): сравнения с границами, OR по блоку,
+// упаковка 16 значений двумя packs с насыщением
+inline int packCheckedSse2(const int* src, int8_t* dst, int count) {
+    const __m128i hi = _mm_set1_epi32(100);
+    const __m128i lo = _mm_set1_epi32(-100);
+    int i = 0;
+    for (; i + kPackBlock <= count; i += kPackBlock) {
+        __m128i bad = _mm_setzero_si128();
+        for (int j = 0; j < kPackBlock; j += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + j));
+            bad = _mm_or_si128(bad, _mm_or_si128(_mm_cmpgt_epi32(v, hi), _mm_cmplt_epi32(v, lo)));
+        }
+        if (_mm_movemask_epi8(bad) != 0) {
+            return i + packCheckedScalar(src + i, dst + i, kPackBlock);
+        }
+        for (int j = 0; j < kPackBlock; j += 16) {
+            const __m128i* p = reinterpret_cast<const __m128i*>(src + i + j);
+            __m128i ab = _mm_packs_epi32(_mm_loadu_si128(p), _mm_loadu_si128(p + 1));
+            __m128i cd = _mm_packs_epi32(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + j), _mm_packs_epi16(ab, cd));
+        }
+    }
+    return i + packCheckedScalar(src + i, dst + i, count - i);
+}
+
+// AVX2: min/max-редукция по блоку; packs работает внутри 128-битных
+// половин, поэтому порядок 32-битных групп восстанавливается перестановкой
+__attribute__((target("avx2")))
+inline int packCheckedAvx2(const int* src, int8_t* dst, int count) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int i = 0;
+    for (; i + kPackBlock <= count; i += kPackBlock) {
+        __m256i vmin = _mm256_set1_epi32(0);
+        __m256i vmax = _mm256_set1_epi32(0);
+        for (int j = 0; j < kPackBlock; j += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + j));
+            vmin = _mm256_min_epi32(vmin, v);
+            vmax = _mm256_max_epi32(vmax, v);
+        }
+        __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi32(vmax, _mm256_set1_epi32(100)),
+                                      _mm256_cmpgt_epi32(_mm256_set1_epi32(-100), vmin));
+        if (!_mm256_testz_si256(bad, bad)) {
+            return i + packCheckedScalar(src + i, dst + i, kPackBlock);
+        }
+        for (int j = 0; j < kPackBlock; j += 32) {
+            const __m256i* p = reinterpret_cast<const __m256i*>(src + i + j);
+            __m256i ab = _mm256_packs_epi32(_mm256_loadu_si256(p), _mm256_loadu_si256(p + 1));
+            __m256i cd = _mm256_packs_epi32(_mm256_loadu_si256(p + 2), _mm256_loadu_si256(p + 3));
+            __m256i packed = _mm256_permutevar8x32_epi32(_mm256_packs_epi16(ab, cd), order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + j), packed);
+        }
+    }
+    return i + packCheckedScalar(src + i, dst + i, count - i);
+}
+#endif
+
+inline int packChecked(const int* src, int8_t* dst, int count) {
+#ifdef PZ6_HAS_X86_SIMD
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    if (hasAvx2) {
+        return packCheckedAvx2(src, dst, count);
+    }
+    return packCheckedSse2(src, dst, count);
+#else
+    return packCheckedScalar(src, dst, count);
+#endif
+}
+
+// Результат пакетной записи: вместо исключения - статус и место ошибки
+struct BulkResult {
+    enum Status { Ok, BadValue, BadRange };
+    
+    Status status = Ok;
+    int badIndex = -1;  // BadValue: индекс первого недопустимого значения во входных данных
+    int written = 0;    // сколько элементов записано в массив
+    
+    bool ok() const {
+        return status == Ok;
+    }
+};
+
+// Метка "данные уже проверены": конструктор Array с ней не проверяет значения
+struct KnownValid {};
 
 class Array {
 private:
-    int* data;
+    // Значения из [-100, 100] помещаются в один байт: храним int8_t,
+    // наружу отдаём int. Буфер общий у копий (копирование при записи):
+    // перед изменением вызывается detach(), data указывает в buffer.
+    std::shared_ptr<int8_t[]> buffer;
+    int8_t* data;
     int size;
     
+    // Частоты значений: counts[v + 100] - сколько элементов равны v
+    using Histogram = std::array<int, 201>;
+    // Индекс частот (enableIndex): поддерживается при каждой записи,
+    // статистика по нему не зависит от длины массива
+    std::unique_ptr<Histogram> index;
+    
     // Проверка значения на соответствие диапазону
     bool isValidValue(int value) const {
-        return (value >= -100 && value <= 100);
+        bool valid = (value >= -100 && value <= 100);
+        if (!valid) {
+            INSTR_COUNT("pz6.invalid_value");
+        }
+        return valid;
     }
     
     // Проверка индекса на валидность
     bool isValidIndex(int index) const {
-        return (index >= 0 && index < size);
+        bool valid = (index >= 0 && index < size);
+        if (!valid) {
+            INSTR_COUNT("pz6.invalid_index");
+        }
+        return valid;
+    }
+    
+    // Собственный буфер перед записью: если он общий с копиями, элементы
+    // копируются (keepValues = false - содержимое всё равно будет перезаписано)
+    void detach(bool keepValues = true) {
+        if (buffer.use_count() > 1) {
+            std::shared_ptr<int8_t[]> own(new int8_t[size]);
+            if (keepValues) {
+                std::copy(data, data + size, own.get());
+            }
+            buffer = std::move(own);
+            data = buffer.get();
+        }
+    }
+    
+    // Запись одного проверенного значения с обновлением индекса
+    void store(int position, int value) {
+        detach();
+        if (index) {
+            (*index)[data[position] + 100]--;
+            (*index)[value + 100]++;
+        }
+        data[position] = static_cast<int8_t>(value);
+    }
+    
+    // Добавление (sign = 1) или вычитание (sign = -1) частот data[first..last)
+    void countRange(Histogram& counts, int first, int last, int sign) const {
+        for (int i = first; i < last; i++) {
+            counts[data[i] + 100] += sign;
+        }
+    }
+    
+    // Куски массива на задачу пула при подсчёте частот: частоты куска
+    // (201 счётчик) копируются и складываются, поэтому куски крупные
+    static const size_t kCountGrain = size_t(1) << 18;
+    
+    // Частоты всего массива: куски считаются параллельно на общем пуле
+    Histogram countAll() const {
+        return parallelMapReduce(static_cast<size_t>(size), Histogram{}, [&](size_t begin, size_t end) {
+            Histogram counts{};
+            countRange(counts, static_cast<int>(begin), static_cast<int>(end), 1);
+            return counts;
+        }, [](Histogram total, const Histogram& part) {
+            for (int v = 0; v < 201; v++) {
+                total[v] += part[v];
+            }
+            return total;
+        }, kCountGrain);
+    }
+    
+    // Частоты из индекса, а без него - одним проходом по массиву
+    Histogram histogram() const {
+        if (index) {
+            return *index;
+        }
+        return countAll();
+    }
+    
+    // Сумма data[first..last): группы по kGroup элементов с постоянной
+    // длиной цикла суммируются в int (|сумма группы| <= 100 * kGroup) -
+    // такой цикл компилятор векторизует уже при -O2
+    long long sumRange(int first, int last) const {
+        const int kGroup = 256;
+        long long total = 0;
+        int i = first;
+        for (; i + kGroup <= last; i += kGroup) {
+            const int8_t* group = data + i;
+            int partial = 0;
+            for (int j = 0; j < kGroup; j++) {
+                partial += group[j];
+            }
+            total += partial;
+        }
+        for (; i < last; i++) {
+            total += data[i];
+        }
+        return total;
+    }
+    
+    // Значение элемента с номером rank (с 1) в отсортированном порядке
+    static int valueAtRank(const Histogram& counts, long long rank) {
+        long long seen = 0;
+        for (int v = 0; v < 201; v++) {
+            seen += counts[v];
+            if (seen >= rank) {
+                return v - 100;
+            }
+        }
+        return 100;
+    }
+    
+    void requireNotEmpty() const {
+        if (size == 0) {
+            throw std::out_of_range("Массив пуст");
+        }
     }
 
 public:
@@ -24,45 +262,65 @@ public:
             throw std::invalid_argument("Размер массива должен быть положительным числом");
         }
         this->size = size;
-        data = new int[size];
+        buffer.reset(new int8_t[size]);
+        data = buffer.get();
         // Инициализация нулями (0 входит в диапазон)
         for (int i = 0; i < size; i++) {
             data[i] = 0;
         }
     }
     
-    // Деструктор
-    ~Array() {
-        delete[] data;
-    }
-    
-    // Конструктор копирования
-    Array(const Array& other) {
-        size = other.size;
-        data = new int[size];
+    // Конструктор из заведомо допустимых значений: проверка пропускается
+    Array(const int* values, int size, KnownValid) {
+        if (size <= 0) {
+            throw std::invalid_argument("Размер массива должен быть положительным числом");
+        }
+        this->size = size;
+        buffer.reset(new int8_t[size]);
+        data = buffer.get();
         for (int i = 0; i < size; i++) {
-            data[i] = other.data[i];
+            data[i] = static_cast<int8_t>(values[i]);
         }
     }
     
+    // Деструктор (буфер освобождает последний владелец)
+    ~Array() {}
+    
+    // Конструктор копирования: O(1), буфер становится общим до первой записи.
+    // Значения в Array всегда проверены, поэтому повторная проверка не нужна.
+    // Индекс частот копируется вместе с массивом.
+    Array(const Array& other)
+        : buffer(other.buffer), data(other.data), size(other.size),
+          index(other.index ? new Histogram(*other.index) : nullptr) {}
+    
+    // Конструктор перемещения: буфер забирается, other остаётся пустым
+    Array(Array&& other) noexcept
+        : buffer(std::move(other.buffer)), data(other.data), size(other.size),
+          index(std::move(other.index)) {
+        other.data = nullptr;
+        other.size = 0;
+    }
+    
     // Оператор присваивания
     Array& operator=(const Array& other) {
         if (this != &other) {
-            // Проверяем все значения перед копированием
-            for (int i = 0; i < other.size; i++) {
-                if (!isValidValue(other.data[i])) {
-                    throw std::invalid_argument("Невозможно скопировать массив: содержит значение " + 
-                                               std::to_string(other.data[i]) + 
-                                               " вне диапазона [-100, 100]");
-                }
-            }
-            
-            delete[] data;
+            buffer = other.buffer;
+            data = other.data;
             size = other.size;
-            data = new int[size];
-            for (int i = 0; i < size; i++) {
-                data[i] = other.data[i];
-            }
+            index.reset(other.index ? new Histogram(*other.index) : nullptr);
+        }
+        return *this;
+    }
+    
+    // Перемещающее присваивание
+    Array& operator=(Array&& other) noexcept {
+        if (this != &other) {
+            buffer = std::move(other.buffer);
+            data = other.data;
+            size = other.size;
+            index = std::move(other.index);
+            other.data = nullptr;
+            other.size = 0;
         }
         return *this;
     }
@@ -73,7 +331,7 @@ public:
     }
     
     // Оператор [] для получения элемента (константная версия)
-    const int& operator[](int index) const {
+    int operator[](int index) const {
         if (!isValidIndex(index)) {
             throw std::out_of_range("Индекс " + std::to_string(index) + 
                                    " выходит за границы массива [0, " + 
@@ -97,7 +355,7 @@ public:
                 throw std::invalid_argument("Значение " + std::to_string(value) + 
                                            " должно быть в диапазоне [-100, 100]");
             }
-            array.data[index] = value;
+            array.store(index, value);
             return *this;
         }
         
@@ -130,7 +388,7 @@ public:
                                        " должно быть в диапазоне [-100, 100]");
         }
         
-        data[index] = value;
+        store(index, value);
     }
     
     // Получение значения
@@ -147,7 +405,7 @@ public:
     void print() const {
         std::cout << "[";
         for (int i = 0; i < size; i++) {
-            std::cout << data[i];
+            std::cout << static_cast<int>(data[i]);
             if (i < size - 1) {
                 std::cout << ", ";
             }
@@ -162,14 +420,304 @@ public:
                                        " должно быть в диапазоне [-100, 100]");
         }
         
+        detach(false);
         for (int i = 0; i < size; i++) {
-            data[i] = value;
+            data[i] = static_cast<int8_t>(value);
         }
+        if (index) {
+            index->fill(0);
+            (*index)[value + 100] = size;
+        }
+    }
+    
+    // Запись count значений с позиции first за один проход: проверка и
+    // упаковка идут блоками. Как и поэлементная запись, останавливается на
+    // первом недопустимом значении - элементы до него уже записаны.
+    BulkResult setRange(int first, const int* values, int count) {
+        BulkResult result;
+        if (first < 0 || count < 0 || count > size - first) {
+            result.status = BulkResult::BadRange;
+            return result;
+        }
+        detach();
+        // Частоты диапазона пересчитываются: старые значения вычитаются до
+        // записи, а после неё добавляются текущие (новые и незаписанные)
+        if (index) {
+            countRange(*index, first, first + count, -1);
+        }
+        result.written = packChecked(values, data + first, count);
+        if (index) {
+            countRange(*index, first, first + count, 1);
+        }
+        if (result.written < count) {
+            result.status = BulkResult::BadValue;
+            result.badIndex = result.written;
+        }
+        return result;
+    }
+    
+    BulkResult setRange(int first, const std::vector<int>& values) {
+        return setRange(first, values.data(), static_cast<int>(values.size()));
+    }
+    
+    // Замена всего содержимого (размер становится count). Всё или ничего:
+    // при ошибке массив не меняется.
+    BulkResult assign(const int* values, int count) {
+        BulkResult result;
+        if (count <= 0) {
+            result.status = BulkResult::BadRange;
+            return result;
+        }
+        std::shared_ptr<int8_t[]> fresh(new int8_t[count]);
+        result.written = packChecked(values, fresh.get(), count);
+        if (result.written < count) {
+            result.status = BulkResult::BadValue;
+            result.badIndex = result.written;
+            result.written = 0;
+            return result;
+        }
+        buffer = std::move(fresh);
+        data = buffer.get();
+        size = count;
+        if (index) {
+            *index = countAll();
+        }
+        return result;
+    }
+    
+    BulkResult assign(const std::vector<int>& values) {
+        return assign(values.data(), static_cast<int>(values.size()));
+    }
+    
+    // Индекс частот: строится за один проход и дальше поддерживается
+    // каждой записью (setValue, [], fill, setRange, assign, копирование).
+    // С ним count/min/max/median/percentile/sum не просматривают массив.
+    void enableIndex() {
+        if (!index) {
+            index.reset(new Histogram(countAll()));
+        }
+    }
+    
+    void disableIndex() {
+        index.reset();
+    }
+    
+    bool hasIndex() const {
+        return index != nullptr;
+    }
+    
+    // Сколько элементов равны value (вне диапазона - ни одного)
+    int count(int value) const {
+        if (!inRange(value)) {
+            return 0;
+        }
+        if (index) {
+            return (*index)[value + 100];
+        }
+        return static_cast<int>(std::count(data, data + size, static_cast<int8_t>(value)));
+    }
+    
+    int min() const {
+        requireNotEmpty();
+        Histogram counts = histogram();
+        int v = 0;
+        while (counts[v] == 0) {
+            v++;
+        }
+        return v - 100;
+    }
+    
+    int max() const {
+        requireNotEmpty();
+        Histogram counts = histogram();
+        int v = 200;
+        while (counts[v] == 0) {
+            v--;
+        }
+        return v - 100;
+    }
+    
+    // Процентиль p из [0, 100] методом ближайшего ранга: наименьшее
+    // значение, не меньше которого хотя бы p% элементов
+    int percentile(double p) const {
+        requireNotEmpty();
+        if (!(p >= 0.0 && p <= 100.0)) {
+            throw std::invalid_argument("Процентиль должен быть в диапазоне [0, 100]");
+        }
+        long long rank = static_cast<long long>(std::ceil(p / 100.0 * size));
+        return valueAtRank(histogram(), rank < 1 ? 1 : rank);
+    }
+    
+    // Медиана; для чётного размера - среднее двух средних элементов
+    double median() const {
+        requireNotEmpty();
+        Histogram counts = histogram();
+        int lower = valueAtRank(counts, (size + 1) / 2);
+        int upper = valueAtRank(counts, size / 2 + 1);
+        return (size % 2 == 1) ? lower : (lower + upper) / 2.0;
+    }
+    
+    // Сумма всех элементов. С индексом - по частотам, без него кусками
+    // на общем пуле потоков (см. sumRange)
+    long long sum() const {
+        if (index) {
+            long long total = 0;
+            for (int v = 0; v < 201; v++) {
+                total += static_cast<long long>((*index)[v]) * (v - 100);
+            }
+            return total;
+        }
+        return parallelMapReduce(static_cast<size_t>(size), 0LL, [&](size_t begin, size_t end) {
+            return sumRange(static_cast<int>(begin), static_cast<int>(end));
+        }, std::plus<long long>());
+    }
+    
+    // Сортировка подсчётом: значений всего 201, поэтому по частотам каждый
+    // кусок массива сразу заполняется своими значениями (параллельно).
+    // Частоты не меняются, индекс остаётся верным
+    void sort() {
+        Histogram counts = histogram();
+        std::array<int, 202> starts{};  // starts[v] - первая позиция значения v - 100
+        for (int v = 0; v < 201; v++) {
+            starts[v + 1] = starts[v] + counts[v];
+        }
+        detach(false);
+        parallelFor(static_cast<size_t>(size), [&](size_t begin, size_t end) {
+            int position = static_cast<int>(begin);
+            int v = static_cast<int>(std::upper_bound(starts.begin(), starts.end(), position) - starts.begin()) - 1;
+            while (position < static_cast<int>(end)) {
+                int last = std::min(starts[v + 1], static_cast<int>(end));
+                std::memset(data + position, v - 100, last - position);
+                position = last;
+                v++;
+            }
+        });
+    }
+    
+    // Замена каждого элемента на fn(элемент) на общем пуле потоков. Всё или
+    // ничего: если fn вернула значение вне [-100, 100], массив не меняется,
+    // а badIndex - первый такой элемент
+    template<typename Fn>
+    BulkResult transform(Fn fn) {
+        BulkResult result;
+        std::shared_ptr<int8_t[]> fresh(new int8_t[size]);
+        int8_t* out = fresh.get();
+        std::atomic<int> firstBad(size);
+        parallelFor(static_cast<size_t>(size), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                int value = fn(static_cast<int>(data[i]));
+                if (!inRange(value)) {
+                    int bad = firstBad.load(std::memory_order_relaxed);
+                    while (static_cast<int>(i) < bad &&
+                           !firstBad.compare_exchange_weak(bad, static_cast<int>(i), std::memory_order_relaxed)) {}
+                    return;
+                }
+                out[i] = static_cast<int8_t>(value);
+            }
+        });
+        if (firstBad.load() < size) {
+            INSTR_COUNT("pz6.invalid_value");
+            result.status = BulkResult::BadValue;
+            result.badIndex = firstBad.load();
+            return result;
+        }
+        buffer = std::move(fresh);
+        data = buffer.get();
+        result.written = size;
+        if (index) {
+            *index = countAll();
+        }
+        return result;
+    }
+    
+    // Сколько элементов удовлетворяют pred (параллельно)
+    template<typename Pred>
+    int countIf(Pred pred) const {
+        return static_cast<int>(parallelCountIf(data, static_cast<size_t>(size), [&](int8_t v) {
+            return pred(static_cast<int>(v));
+        }));
+    }
+    
+    // Индекс первого элемента, для которого pred истинен, или -1
+    template<typename Pred>
+    int find(Pred pred) const {
+        size_t found = parallelFind(data, static_cast<size_t>(size), [&](int8_t v) {
+            return pred(static_cast<int>(v));
+        });
+        return found < static_cast<size_t>(size) ? static_cast<int>(found) : -1;
     }
 };
 
-// Пример использования с обработкой исключений
-int main() {
+// Замер: память и скорость полного прохода для int8_t-хранения
+// в сравнении с тем же массивом из int
+void runBenchmark(int n) {
+    Array arr(n);
+    int* plain = new int[n];
+    for (int i = 0; i < n; i++) {
+        int value = i % 201 - 100;
+        arr.setValue(i, value);
+        plain[i] = value;
+    }
+    
+    const int kRepeats = 10;
+    auto measure = [&](auto&& scan) {
+        long long result = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < kRepeats; r++) {
+            result += scan();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return std::make_pair(elapsed.count() / kRepeats, result);
+    };
+    
+    auto packed = measure([&]() { return arr.sum(); });
+    auto wide = measure([&]() {
+        long long total = 0;
+        for (int i = 0; i < n; i++) {
+            total += plain[i];
+        }
+        return total;
+    });
+    
+    double mb = 1024.0 * 1024.0;
+    std::cout << "Элементов: " << n << std::endl;
+    std::cout << "Память int:    " << n * sizeof(int) / mb << " МиБ" << std::endl;
+    std::cout << "Память int8_t: " << n * sizeof(int8_t) / mb << " МиБ" << std::endl;
+    std::cout << "Проход int:    " << wide.first * 1000 << " мс" << std::endl;
+    std::cout << "Проход int8_t: " << packed.first * 1000 << " мс (ускорение "
+              << wide.first / packed.first << "x)" << std::endl;
+    if (packed.second != wide.second) {
+        std::cout << "Суммы не совпадают!" << std::endl;
+    }
+    
+    // Пакетная загрузка: setRange против поэлементного setValue
+    auto bulk = measure([&]() { return static_cast<long long>(arr.setRange(0, plain, n).written); });
+    auto single = measure([&]() {
+        for (int i = 0; i < n; i++) {
+            arr.setValue(i, plain[i]);
+        }
+        return static_cast<long long>(n);
+    });
+    double gb = 1024.0 * 1024.0 * 1024.0;
+    std::cout << "Загрузка setValue: " << single.first * 1000 << " мс" << std::endl;
+    std::cout << "Загрузка setRange: " << bulk.first * 1000 << " мс ("
+              << n * (sizeof(int) + sizeof(int8_t)) / gb / bulk.first << " ГиБ/с)" << std::endl;
+    delete[] plain;
+}
+
+// Пример использования с обработкой исключений.
+// "pz6 --bench [N]" - замер хранения int8_t на N элементах
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        try {
+            runBenchmark(argc > 2 ? std::stoi(argv[2]) : 100000000);
+        }
+        catch (const std::exception& e) {
+            std::cout << "Ошибка замера: " << e.what() << std::endl;
+        }
+        return 0;
+    }
+    
     try {
         // Создание массива
         Array arr(5);
@@ -271,10 +819,46 @@ int main() {
         std::cout << "\n4. Текущее состояние массива: ";
         arr.print();
         
+        // Копия делит буфер с оригиналом до первой записи
+        std::cout << "\n5. Копирование при записи и перемещение:" << std::endl;
+        Array shared = arr;
+        shared[0] = 1;
+        std::cout << "Копия после записи: ";
+        shared.print();
+        std::cout << "Оригинал не изменился: ";
+        arr.print();
+        Array moved = std::move(shared);
+        std::cout << "Перемещённый массив: ";
+        moved.print();
+        
+        // Статистика по индексу частот не просматривает массив
+        std::cout << "\n6. Статистика по индексу частот:" << std::endl;
+        moved.enableIndex();
+        moved[1] = 100;
+        std::cout << "min = " << moved.min() << ", max = " << moved.max()
+                  << ", медиана = " << moved.median() << ", сумма = " << moved.sum()
+                  << ", count(100) = " << moved.count(100) << std::endl;
+        
+        // Массовые операции: большие массивы обрабатываются на пуле потоков
+        std::cout << "\n7. Массовые операции:" << std::endl;
+        BulkResult doubled = moved.transform([](int v) { return v * 2; });
+        std::cout << "transform(v * 2): " << (doubled.ok() ? "выполнено" : "отклонено")
+                  << ", badIndex = " << doubled.badIndex << std::endl;
+        moved.transform([](int v) { return -v; });
+        moved.sort();
+        std::cout << "После transform(-v) и sort(): ";
+        moved.print();
+        std::cout << "Отрицательных: " << moved.countIf([](int v) { return v < 0; })
+                  << ", первый ноль на позиции " << moved.find([](int v) { return v == 0; }) << std::endl;
+        
     } 
     catch (const std::exception& e) {
         std::cout << "Непредвиденное исключение: " << e.what() << std::endl;
     }
     
+#ifdef ARRAY_INSTRUMENTATION
+    std::cout << "\n" << Instrumentation::snapshot().toText();
+#endif
+    
     return 0;
 }
\ No newline at end of file
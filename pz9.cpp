@@ -4,179 +4,2911 @@
 #include <typeinfo>
 #include <cmath>
 #include <type_traits>
+#include <limits>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <new>
+#include <mutex>
+#include <queue>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <chrono>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PZ9_HAS_MMAP 1
+#else
+#include <iterator>
+#endif
+
+#include "instrumentation.h"
+#include "parallel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PZ9_HAS_X86_SIMD 1
+#endif
+
+// Метрики расстояния между массивами одинаковой длины
+enum class Metric { SquaredL2, L1, Dot, Cosine };
+
+// Суммы одного прохода по паре массивов: для SquaredL2/L1/Dot - out[0],
+// для Cosine - out[0] = a·b, out[1] = |a|², out[2] = |b|².
+// Общий (скалярный) вариант для любых числовых типов считает в double.
+template<typename T, Metric M>
+void scalarSums(const T* a, const T* b, size_t n, double* out) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double x = static_cast<double>(a[i]);
+        double y = static_cast<double>(b[i]);
+        if (M == Metric::SquaredL2) {
+            s0 += (x - y) * (x - y);
+        } else if (M == Metric::L1) {
+            s0 += std::fabs(x - y);
+        } else if (M == Metric::Dot) {
+            s0 += x * y;
+        } else {
+            s0 += x * y;
+            s1 += x * x;
+            s2 += y * y;
+        }
+    }
+    out[0] = s0;
+    out[1] = s1;
+    out[2] = s2;
+}
+
+#ifdef __GNUC__
+// Векторные ядра для float, double, int32_t и int8_t. Элементы приводятся
+// к типу накопления (int32_t - к double, int8_t - к int32_t) и суммируются
+// в kUnroll независимых векторов-аккумуляторов, так что цикл упирается в
+// пропускную способность, а не в задержку сложения. Одно и то же ядро
+// собирается для SSE2 (16 байт), AVX2 (32) и AVX-512 (64); нужное
+// выбирается при первом вызове по возможностям процессора.
+template<typename T> struct KernelAcc { using type = T; };
+template<> struct KernelAcc<int32_t> { using type = double; };
+template<> struct KernelAcc<int8_t> { using type = int32_t; };
+
+template<typename T> struct HasVectorKernel : std::false_type {};
+template<> struct HasVectorKernel<float> : std::true_type {};
+template<> struct HasVectorKernel<double> : std::true_type {};
+template<> struct HasVectorKernel<int32_t> : std::true_type {};
+template<> struct HasVectorKernel<int8_t> : std::true_type {};
+
+// kLanes элементов p, приведённых к типу накопления. int8_t расширяется
+// через int16_t: прямой __builtin_convertvector int8 -> int32 GCC 12
+// разбирает поэлементно, а двухшаговый сводит к pmovsx.
+template<typename Acc, int kLanes, typename V, typename T>
+__attribute__((always_inline))
+inline void loadLanes(V& v, const T* p) {
+    if constexpr (std::is_same<T, Acc>::value) {
+        std::memcpy(&v, p, sizeof(v));
+    } else {
+        typedef T SrcV __attribute__((vector_size(kLanes * sizeof(T))));
+        SrcV src;
+        std::memcpy(&src, p, sizeof(src));
+        if constexpr (sizeof(T) == 1) {
+            typedef int16_t WideV __attribute__((vector_size(kLanes * sizeof(int16_t))));
+            v = __builtin_convertvector(__builtin_convertvector(src, WideV), V);
+        } else {
+            v = __builtin_convertvector(src, V);
+        }
+    }
+}
+
+// Сумма kLanes дорожек: сложения пополам в типе накопления (глубина
+// log2(kLanes) вместо цепочки из kLanes сложений), затем перевод в double
+template<typename Acc, int kLanes>
+__attribute__((always_inline))
+inline double sumLanes(const void* v) {
+    Acc lanes[kLanes];
+    std::memcpy(lanes, v, sizeof(lanes));
+#pragma GCC unroll 8
+    for (int width = kLanes / 2; width > 0; width /= 2) {
+#pragma GCC unroll 32
+        for (int k = 0; k < width; k++) {
+            lanes[k] += lanes[k + width];
+        }
+    }
+    return static_cast<double>(lanes[0]);
+}
+
+template<typename T, Metric M, int Bytes>
+__attribute__((always_inline))
+inline void vectorSums(const T* a, const T* b, size_t n, double* out) {
+    using Acc = typename KernelAcc<T>::type;
+    constexpr int kLanes = Bytes / sizeof(Acc);
+    constexpr int kUnroll = 4;
+    constexpr int kSums = M == Metric::Cosine ? 3 : 1;
+    constexpr size_t kStep = kLanes * kUnroll;
+    // Блоки, в которых int32-аккумуляторы int8_t не переполняются
+    // (на дорожку не больше 32768 / kStep квадратов по 65025)
+    constexpr size_t kBlock = 32768 / kStep * kStep;
+    typedef Acc AccV __attribute__((vector_size(Bytes)));
+
+    double total[3] = {0.0, 0.0, 0.0};
+    size_t i = 0;
+    while (n - i >= kStep) {
+        size_t blockEnd = i + std::min(kBlock, (n - i) / kStep * kStep);
+        if constexpr (std::is_floating_point<T>::value) {
+            // Векторы-аккумуляторы живут в регистрах
+            AccV acc[kSums][kUnroll] = {};
+            for (; i < blockEnd; i += kStep) {
+#pragma GCC unroll 4
+                for (int u = 0; u < kUnroll; u++) {
+                    AccV x, y;
+                    loadLanes<Acc, kLanes>(x, a + i + u * kLanes);
+                    loadLanes<Acc, kLanes>(y, b + i + u * kLanes);
+                    if constexpr (M == Metric::SquaredL2) {
+                        AccV d = x - y;
+                        acc[0][u] += d * d;
+                    } else if constexpr (M == Metric::L1) {
+                        AccV d = x - y;
+                        acc[0][u] += d < 0 ? -d : d;
+                    } else if constexpr (M == Metric::Dot) {
+                        acc[0][u] += x * y;
+                    } else {
+                        acc[0][u] += x * y;
+                        acc[kSums - 2][u] += x * x;
+                        acc[kSums - 1][u] += y * y;
+                    }
+                }
+            }
+            for (int k = 0; k < kSums; k++) {
+                AccV sum = (acc[k][0] + acc[k][1]) + (acc[k][2] + acc[k][3]);
+                total[k] += sumLanes<Acc, kLanes>(&sum);
+            }
+        } else {
+            // Для целых - массив дорожек и цикл постоянной длины: его
+            // векторизатор сводит к расширяющим умножениям (pmaddwd)
+            alignas(64) Acc acc[kSums][kStep] = {};
+            for (; i < blockEnd; i += kStep) {
+                for (size_t j = 0; j < kStep; j++) {
+                    Acc x = static_cast<Acc>(a[i + j]);
+                    Acc y = static_cast<Acc>(b[i + j]);
+                    if constexpr (M == Metric::SquaredL2) {
+                        acc[0][j] += (x - y) * (x - y);
+                    } else if constexpr (M == Metric::L1) {
+                        acc[0][j] += x < y ? y - x : x - y;
+                    } else if constexpr (M == Metric::Dot) {
+                        acc[0][j] += x * y;
+                    } else {
+                        acc[0][j] += x * y;
+                        acc[kSums - 2][j] += x * x;
+                        acc[kSums - 1][j] += y * y;
+                    }
+                }
+            }
+            for (int k = 0; k < kSums; k++) {
+                total[k] += sumLanes<Acc, kStep>(acc[k]);
+            }
+        }
+    }
+
+    double tail[3];
+    scalarSums<T, M>(a + i, b + i, n - i, tail);
+    for (int k = 0; k < 3; k++) {
+        out[k] = total[k] + tail[k];
+    }
+}
+
+#ifdef PZ9_HAS_X86_SIMD
+template<typename T, Metric M>
+__attribute__((target("avx512f,avx512bw")))
+void vectorSumsAvx512(const T* a, const T* b, size_t n, double* out) {
+    vectorSums<T, M, 64>(a, b, n, out);
+}
+
+template<typename T, Metric M>
+__attribute__((target("avx2,fma")))
+void vectorSumsAvx2(const T* a, const T* b, size_t n, double* out) {
+    vectorSums<T, M, 32>(a, b, n, out);
+}
+#endif
+
+template<typename T, Metric M>
+void vectorSumsBase(const T* a, const T* b, size_t n, double* out) {
+    vectorSums<T, M, 16>(a, b, n, out);
+}
+
+// Суммы метрики M с выбором ядра при первом вызове
+template<typename T, Metric M>
+typename std::enable_if<HasVectorKernel<T>::value>::type
+metricSums(const T* a, const T* b, size_t n, double* out) {
+    using Kernel = void (*)(const T*, const T*, size_t, double*);
+    static const Kernel kernel = []() -> Kernel {
+#ifdef PZ9_HAS_X86_SIMD
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+            return vectorSumsAvx512<T, M>;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return vectorSumsAvx2<T, M>;
+        }
+#endif
+        return vectorSumsBase<T, M>;
+    }();
+    kernel(a, b, n, out);
+}
+
+template<typename T, Metric M>
+typename std::enable_if<!HasVectorKernel<T>::value>::type
+metricSums(const T* a, const T* b, size_t n, double* out) {
+    scalarSums<T, M>(a, b, n, out);
+}
+#else
+template<typename T, Metric M>
+void metricSums(const T* a, const T* b, size_t n, double* out) {
+    scalarSums<T, M>(a, b, n, out);
+}
+#endif
+
+// Блочные скалярные произведения для ArrayBatch (схема умножения матриц).
+// Набор нарезан на панели по kPanelCols строк, уложенные транспонированно:
+// panel[k * kPanelCols + c] = строка c, элемент k. Ядро умножает kDotRows
+// запросов на панель: out[r * kPanelCols + c] = q[r]·(строка c). Дорожки
+// векторов соответствуют разным строкам набора, поэтому горизонтальных
+// сумм нет, а каждый загруженный вектор панели идёт в kDotRows сложений.
+constexpr int kDotRows = 6;
+constexpr int kPanelCols = 16;
+
+template<typename T>
+void scalarPanelDots(const T* const* q, const T* panel, size_t n, double* out) {
+    for (int r = 0; r < kDotRows; r++) {
+        for (int c = 0; c < kPanelCols; c++) {
+            out[r * kPanelCols + c] = 0.0;
+        }
+    }
+    for (size_t k = 0; k < n; k++) {
+        for (int r = 0; r < kDotRows; r++) {
+            double s = static_cast<double>(q[r][k]);
+            for (int c = 0; c < kPanelCols; c++) {
+                out[r * kPanelCols + c] += s * static_cast<double>(panel[k * kPanelCols + c]);
+            }
+        }
+    }
+}
+
+#ifdef __GNUC__
+// Аккумуляторы - векторные типы GCC, чтобы kDotRows x kVecs векторов жили
+// в регистрах на всю длину строки
+template<typename T, int Bytes>
+__attribute__((always_inline))
+inline void vectorPanelDots(const T* const* q, const T* panel, size_t n, double* out) {
+    using Acc = typename KernelAcc<T>::type;
+    constexpr int kLanes = Bytes / sizeof(Acc) < kPanelCols ? Bytes / sizeof(Acc) : kPanelCols;
+    constexpr int kVecs = kPanelCols / kLanes;
+    constexpr size_t kBlock = 32768;
+    typedef Acc AccV __attribute__((vector_size(kLanes * sizeof(Acc))));
+
+    for (int r = 0; r < kDotRows * kPanelCols; r++) {
+        out[r] = 0.0;
+    }
+    for (size_t begin = 0; begin < n; begin += kBlock) {
+        size_t end = std::min(n, begin + kBlock);
+        AccV acc[kDotRows][kVecs] = {};
+        for (size_t k = begin; k < end; k++) {
+            AccV x[kVecs];
+#pragma GCC unroll 16
+            for (int v = 0; v < kVecs; v++) {
+                loadLanes<Acc, kLanes>(x[v], panel + k * kPanelCols + v * kLanes);
+            }
+#pragma GCC unroll 8
+            for (int r = 0; r < kDotRows; r++) {
+                Acc s = static_cast<Acc>(q[r][k]);
+#pragma GCC unroll 16
+                for (int v = 0; v < kVecs; v++) {
+                    acc[r][v] += s * x[v];
+                }
+            }
+        }
+        for (int r = 0; r < kDotRows; r++) {
+            Acc lanes[kPanelCols];
+            std::memcpy(lanes, acc[r], sizeof(lanes));
+            for (int c = 0; c < kPanelCols; c++) {
+                out[r * kPanelCols + c] += static_cast<double>(lanes[c]);
+            }
+        }
+    }
+}
+
+#ifdef PZ9_HAS_X86_SIMD
+template<typename T>
+__attribute__((target("avx512f,avx512bw")))
+void vectorPanelDotsAvx512(const T* const* q, const T* panel, size_t n, double* out) {
+    vectorPanelDots<T, 64>(q, panel, n, out);
+}
+
+template<typename T>
+__attribute__((target("avx2,fma")))
+void vectorPanelDotsAvx2(const T* const* q, const T* panel, size_t n, double* out) {
+    vectorPanelDots<T, 32>(q, panel, n, out);
+}
+#endif
+
+template<typename T>
+void vectorPanelDotsBase(const T* const* q, const T* panel, size_t n, double* out) {
+    vectorPanelDots<T, 16>(q, panel, n, out);
+}
+
+template<typename T>
+typename std::enable_if<HasVectorKernel<T>::value>::type
+panelDots(const T* const* q, const T* panel, size_t n, double* out) {
+    using Kernel = void (*)(const T* const*, const T*, size_t, double*);
+    static const Kernel kernel = []() -> Kernel {
+#ifdef PZ9_HAS_X86_SIMD
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+            return vectorPanelDotsAvx512<T>;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return vectorPanelDotsAvx2<T>;
+        }
+#endif
+        return vectorPanelDotsBase<T>;
+    }();
+    kernel(q, panel, n, out);
+}
+
+template<typename T>
+typename std::enable_if<!HasVectorKernel<T>::value>::type
+panelDots(const T* const* q, const T* panel, size_t n, double* out) {
+    scalarPanelDots(q, panel, n, out);
+}
+#else
+template<typename T>
+void panelDots(const T* const* q, const T* panel, size_t n, double* out) {
+    scalarPanelDots(q, panel, n, out);
+}
+#endif
+
+// Аллокатор с выравниванием Alignment байт (по умолчанию - кэш-линия):
+// начало массива не делит кэш-линию с чужими данными, и векторные ядра
+// читают его выровненными блоками
+template<typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+    using value_type = T;
+    static constexpr size_t kAlignment = Alignment > alignof(T) ? Alignment : alignof(T);
+    
+    template<typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+    
+    AlignedAllocator() = default;
+    
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+    
+    T* allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(kAlignment)));
+    }
+    
+    void deallocate(T* p, size_t) {
+        ::operator delete(p, std::align_val_t(kAlignment));
+    }
+    
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const {
+        return true;
+    }
+    
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const {
+        return false;
+    }
+};
+
+template<typename A> struct IsPmrAllocator : std::false_type {};
+template<typename U> struct IsPmrAllocator<std::pmr::polymorphic_allocator<U>> : std::true_type {};
+
+template<typename T, typename Alloc = AlignedAllocator<T>>
+class Array;
 
-// Шаблонный класс массива
 template<typename T>
-class Array {
+class MappedArray;
+
+// Заголовок файла массива (Array::save, MappedArray): "PZ9ARRY1", размер
+// элемента и число элементов (uint64), нули до kSize байт - так элементы
+// в отображённом файле выровнены на 64 байта
+struct ArrayFileHeader {
+    static constexpr char kMagic[8] = {'P', 'Z', '9', 'A', 'R', 'R', 'Y', '1'};
+    static constexpr size_t kSize = 64;
+    
+    static void encode(char* out, uint64_t elementSize, uint64_t count) {
+        std::memset(out, 0, kSize);
+        std::memcpy(out, kMagic, sizeof(kMagic));
+        std::memcpy(out + 8, &elementSize, sizeof(elementSize));
+        std::memcpy(out + 16, &count, sizeof(count));
+    }
+    
+    // Число элементов; исключение, если файл не массив из elementSize-байтных
+    // элементов или его длина не совпадает с заголовком
+    static size_t decode(const char* in, size_t fileBytes, uint64_t elementSize, const std::string& path) {
+        uint64_t header[2] = {0, 0};
+        if (fileBytes >= kSize) {
+            std::memcpy(header, in + 8, sizeof(header));
+        }
+        if (fileBytes < kSize || std::memcmp(in, kMagic, sizeof(kMagic)) != 0 || 
+            header[0] != elementSize || header[1] == 0 || 
+            header[1] != (fileBytes - kSize) / elementSize || (fileBytes - kSize) % elementSize != 0) {
+            throw std::runtime_error("Неверный формат файла массива: " + path);
+        }
+        return static_cast<size_t>(header[1]);
+    }
+};
+
+// Ленивые поэлементные выражения над Array (expression templates).
+// a - b * c строит дерево узлов, а не временные массивы; всё выражение
+// вычисляется одним циклом при присваивании в Array или в свёртке
+// (sum, norm). Узлы хранят массивы по ссылке, поэтому выражение нельзя
+// сохранять (auto e = a + b) дольше самих массивов - его нужно сразу
+// присвоить или свернуть.
+template<typename E>
+struct ArrayExpr {
+    const E& self() const {
+        return static_cast<const E&>(*this);
+    }
+};
+
+// Число, участвующее в выражении как массив из одинаковых значений
+template<typename S>
+struct ScalarExpr : ArrayExpr<ScalarExpr<S>> {
+    S value;
+    
+    explicit ScalarExpr(S value) : value(value) {}
+    
+    S operator[](size_t) const {
+        return value;
+    }
+};
+
+template<typename E> struct IsScalarExpr : std::false_type {};
+template<typename S> struct IsScalarExpr<ScalarExpr<S>> : std::true_type {};
+
+// Как узел хранит операнд: массивы - по ссылке, узлы - по значению
+template<typename E> struct ExprOperand { using type = const E; };
+template<typename T, typename Alloc> struct ExprOperand<Array<T, Alloc>> { using type = const Array<T, Alloc>&; };
+template<typename T> struct ExprOperand<MappedArray<T>> { using type = const MappedArray<T>&; };
+
+struct AddOp { template<typename A, typename B> static auto apply(A a, B b) { return a + b; } };
+struct SubOp { template<typename A, typename B> static auto apply(A a, B b) { return a - b; } };
+struct MulOp { template<typename A, typename B> static auto apply(A a, B b) { return a * b; } };
+struct DivOp { template<typename A, typename B> static auto apply(A a, B b) { return a / b; } };
+struct NegOp { template<typename A> static auto apply(A a) { return -a; } };
+struct AbsOp { template<typename A> static auto apply(A a) { return a < 0 ? -a : a; } };
+struct SqrtOp { template<typename A> static auto apply(A a) { return std::sqrt(a); } };
+
+template<typename Op, typename L, typename R>
+struct BinaryExpr : ArrayExpr<BinaryExpr<Op, L, R>> {
+    typename ExprOperand<L>::type left;
+    typename ExprOperand<R>::type right;
+    
+    BinaryExpr(const L& left, const R& right) : left(left), right(right) {
+        if constexpr (!IsScalarExpr<L>::value && !IsScalarExpr<R>::value) {
+            if (left.getSize() != right.getSize()) {
+                throw std::invalid_argument("Массивы должны иметь одинаковый размер: " + 
+                                           std::to_string(left.getSize()) + " != " + 
+                                           std::to_string(right.getSize()));
+            }
+        }
+    }
+    
+    size_t getSize() const {
+        if constexpr (IsScalarExpr<L>::value) {
+            return right.getSize();
+        } else {
+            return left.getSize();
+        }
+    }
+    
+    auto operator[](size_t i) const {
+        return Op::apply(left[i], right[i]);
+    }
+};
+
+template<typename Op, typename E>
+struct UnaryExpr : ArrayExpr<UnaryExpr<Op, E>> {
+    typename ExprOperand<E>::type operand;
+    
+    explicit UnaryExpr(const E& operand) : operand(operand) {}
+    
+    size_t getSize() const {
+        return operand.getSize();
+    }
+    
+    auto operator[](size_t i) const {
+        return Op::apply(operand[i]);
+    }
+};
+
+template<typename S>
+using EnableIfScalar = typename std::enable_if<std::is_arithmetic<S>::value>::type;
+
+#define PZ9_EXPR_BINARY_OPERATOR(symbol, Op) \
+    template<typename L, typename R> \
+    BinaryExpr<Op, L, R> operator symbol(const ArrayExpr<L>& l, const ArrayExpr<R>& r) { \
+        return BinaryExpr<Op, L, R>(l.self(), r.self()); \
+    } \
+    template<typename L, typename S, typename = EnableIfScalar<S>> \
+    BinaryExpr<Op, L, ScalarExpr<S>> operator symbol(const ArrayExpr<L>& l, S s) { \
+        return BinaryExpr<Op, L, ScalarExpr<S>>(l.self(), ScalarExpr<S>(s)); \
+    } \
+    template<typename S, typename R, typename = EnableIfScalar<S>> \
+    BinaryExpr<Op, ScalarExpr<S>, R> operator symbol(S s, const ArrayExpr<R>& r) { \
+        return BinaryExpr<Op, ScalarExpr<S>, R>(ScalarExpr<S>(s), r.self()); \
+    }
+
+PZ9_EXPR_BINARY_OPERATOR(+, AddOp)
+PZ9_EXPR_BINARY_OPERATOR(-, SubOp)
+PZ9_EXPR_BINARY_OPERATOR(*, MulOp)
+PZ9_EXPR_BINARY_OPERATOR(/, DivOp)
+
+#undef PZ9_EXPR_BINARY_OPERATOR
+
+template<typename E>
+UnaryExpr<NegOp, E> operator-(const ArrayExpr<E>& e) {
+    return UnaryExpr<NegOp, E>(e.self());
+}
+
+template<typename E>
+UnaryExpr<AbsOp, E> abs(const ArrayExpr<E>& e) {
+    return UnaryExpr<AbsOp, E>(e.self());
+}
+
+template<typename E>
+UnaryExpr<SqrtOp, E> sqrt(const ArrayExpr<E>& e) {
+    return UnaryExpr<SqrtOp, E>(e.self());
+}
+
+// Элемент выражения для свёртки: целые уже 64 бит вычисляются в int64_t,
+// чтобы a - b и a * b над Array<int> не переполнялись (деление остаётся
+// целочисленным, как при присваивании в Array)
+template<typename V>
+auto widenForReduce(V v) {
+    if constexpr (std::is_integral<V>::value && sizeof(V) < sizeof(int64_t)) {
+        return static_cast<int64_t>(v);
+    } else {
+        return v;
+    }
+}
+
+template<typename E>
+auto reduceValue(const E& e, size_t i) {
+    return widenForReduce(e[i]);
+}
+
+template<typename Op, typename L, typename R>
+auto reduceValue(const BinaryExpr<Op, L, R>& e, size_t i) {
+    return Op::apply(reduceValue(e.left, i), reduceValue(e.right, i));
+}
+
+template<typename Op, typename E>
+auto reduceValue(const UnaryExpr<Op, E>& e, size_t i) {
+    return Op::apply(reduceValue(e.operand, i));
+}
+
+// Свёртка f(e[i]) в double за один проход. Сумма идёт в kLanes
+// независимых аккумуляторов - цикл постоянной длины компилятор
+// векторизует без -ffast-math, порядок сложения фиксирован.
+template<typename E, typename F>
+double reduceExpr(const ArrayExpr<E>& expr, F f) {
+    constexpr size_t kLanes = 8;
+    const E& e = expr.self();
+    size_t n = e.getSize();
+    size_t blocked = n / kLanes * kLanes;
+    double lanes[kLanes] = {};
+    for (size_t i = 0; i < blocked; i += kLanes) {
+        for (size_t j = 0; j < kLanes; j++) {
+            lanes[j] += f(static_cast<double>(reduceValue(e, i + j)));
+        }
+    }
+    double total = 0.0;
+    for (size_t i = blocked; i < n; i++) {
+        total += f(static_cast<double>(reduceValue(e, i)));
+    }
+    for (size_t j = 0; j < kLanes; j++) {
+        total += lanes[j];
+    }
+    return total;
+}
+
+template<typename E>
+double sum(const ArrayExpr<E>& e) {
+    return reduceExpr(e, [](double x) { return x; });
+}
+
+// Евклидова норма: norm(a - b) совпадает с Array::euclideanDistance(a, b)
+// с точностью до округления (порядок сложения другой); целые шире 32 бит
+// в a - b могут переполниться
+template<typename E>
+double norm(const ArrayExpr<E>& e) {
+    return std::sqrt(reduceExpr(e, [](double x) { return x * x; }));
+}
+
+// Шаблонный класс массива (объявлен выше, вместе с выражениями).
+// Память берётся у Alloc одним блоком без инициализации, элементы
+// создаются на месте: для тривиальных T - memset нулями и memcpy при
+// копировании, для остальных - конструкторы по одному. С аллокатором по
+// умолчанию и с std::pmr::polymorphic_allocator блок выровнен на 64 байта
+// (pmr-ресурс получает выравнивание явно), с прочими - как даст аллокатор.
+template<typename T, typename Alloc>
+class Array : public ArrayExpr<Array<T, Alloc>> {
 private:
+    using Traits = std::allocator_traits<Alloc>;
+    static constexpr size_t kPmrAlignment = 64 > alignof(T) ? 64 : alignof(T);
+    
+    Alloc alloc;
     T* data;
     size_t size;
     
 public:
+    using allocator_type = Alloc;
+    
     // Конструктор
-    explicit Array(size_t size) : size(size) {
+    explicit Array(size_t size, const Alloc& alloc = Alloc()) : alloc(alloc), data(nullptr), size(size) {
         if (size <= 0) {
             throw std::invalid_argument("Размер массива должен быть положительным числом");
         }
-        data = new T[size];
+        data = allocate(size);
         // Инициализация значениями по умолчанию
-        for (size_t i = 0; i < size; i++) {
-            data[i] = T();
+        if (std::is_trivial<T>::value) {
+            std::memset(static_cast<void*>(data), 0, size * sizeof(T));
+        } else {
+            constructEach([](T* slot, size_t) { ::new (static_cast<void*>(slot)) T(); });
         }
     }
     
     // Деструктор
     ~Array() {
-        delete[] data;
+        release();
+    }
+    
+    // Конструктор копирования
+    Array(const Array& other) 
+        : alloc(Traits::select_on_container_copy_construction(other.alloc)), 
+          data(nullptr), size(other.size) {
+        if (size > 0) {
+            data = allocate(size);
+            copyFrom(other);
+        }
+    }
+    
+    // Конструктор перемещения: забирает буфер, other остаётся пустым
+    // (getSize() == 0; его можно только присвоить или уничтожить)
+    Array(Array&& other) noexcept 
+        : alloc(std::move(other.alloc)), data(other.data), size(other.size) {
+        other.data = nullptr;
+        other.size = 0;
+    }
+    
+    // Оператор присваивания
+    Array& operator=(const Array& other) {
+        if (this == &other) {
+            return *this;
+        }
+        bool propagate = Traits::propagate_on_container_copy_assignment::value && alloc != other.alloc;
+        if (size == other.size && !propagate) {
+            // Тот же размер - копируем поверх, без выделения памяти
+            if (std::is_trivially_copyable<T>::value) {
+                std::memcpy(static_cast<void*>(data), other.data, size * sizeof(T));
+            } else {
+                std::copy(other.data, other.data + size, data);
+            }
+            return *this;
+        }
+        Array copy(other.size, other, propagate ? other.alloc : alloc);
+        swapStorage(copy);
+        return *this;
+    }
+    
+    Array& operator=(Array&& other) noexcept(Traits::propagate_on_container_move_assignment::value || 
+                                             Traits::is_always_equal::value) {
+        if (this == &other) {
+            return *this;
+        }
+        if (Traits::propagate_on_container_move_assignment::value || alloc == other.alloc) {
+            release();
+            if constexpr (Traits::propagate_on_container_move_assignment::value) {
+                alloc = std::move(other.alloc);
+            }
+            data = other.data;
+            size = other.size;
+            other.data = nullptr;
+            other.size = 0;
+        } else {
+            // Разные ресурсы (например, две pmr-арены): копия в свою память
+            Array copy(other.size, other, alloc);
+            swapStorage(copy);
+        }
+        return *this;
+    }
+    
+    // Массив из значений выражения (один проход, без промежуточных массивов)
+    template<typename E>
+    Array(const ArrayExpr<E>& expr, const Alloc& alloc = Alloc()) 
+        : alloc(alloc), data(nullptr), size(expr.self().getSize()) {
+        data = allocate(size);
+        const E& e = expr.self();
+        if (std::is_trivial<T>::value) {
+            evaluate(e);
+        } else {
+            constructEach([&](T* slot, size_t i) { ::new (static_cast<void*>(slot)) T(e[i]); });
+        }
+    }
+    
+    // Вычисление выражения на месте; массив может входить в выражение
+    // (a = a * 2 + b), так как i-й элемент зависит только от i-х
+    template<typename E>
+    Array& operator=(const ArrayExpr<E>& expr) {
+        const E& e = expr.self();
+        if (e.getSize() != size) {
+            throw std::invalid_argument("Массивы должны иметь одинаковый размер: " + 
+                                       std::to_string(e.getSize()) + " != " + 
+                                       std::to_string(size));
+        }
+        evaluate(e);
+        return *this;
+    }
+    
+    template<typename E>
+    Array& operator+=(const ArrayExpr<E>& e) {
+        return *this = *this + e;
+    }
+    
+    template<typename E>
+    Array& operator-=(const ArrayExpr<E>& e) {
+        return *this = *this - e;
+    }
+    
+    template<typename E>
+    Array& operator*=(const ArrayExpr<E>& e) {
+        return *this = *this * e;
+    }
+    
+    template<typename E>
+    Array& operator/=(const ArrayExpr<E>& e) {
+        return *this = *this / e;
+    }
+    
+    template<typename S, typename = EnableIfScalar<S>>
+    Array& operator+=(S s) {
+        return *this = *this + s;
+    }
+    
+    template<typename S, typename = EnableIfScalar<S>>
+    Array& operator-=(S s) {
+        return *this = *this - s;
+    }
+    
+    template<typename S, typename = EnableIfScalar<S>>
+    Array& operator*=(S s) {
+        return *this = *this * s;
+    }
+    
+    template<typename S, typename = EnableIfScalar<S>>
+    Array& operator/=(S s) {
+        return *this = *this / s;
+    }
+    
+    Alloc getAllocator() const {
+        return alloc;
+    }
+    
+    // Получение размера
+    size_t getSize() const {
+        return size;
+    }
+    
+    // Оператор [] для доступа к элементам (без проверки границ для производительности)
+    T& operator[](size_t index) {
+        return data[index];
+    }
+    
+    const T& operator[](size_t index) const {
+        return data[index];
+    }
+    
+    // Безопасный доступ с проверкой границ
+    T& at(size_t index) {
+        if (index >= size) {
+            INSTR_COUNT("pz9.at_out_of_range");
+            throw std::out_of_range("Индекс " + std::to_string(index) + 
+                                   " выходит за границы массива [0, " + 
+                                   std::to_string(size - 1) + "]");
+        }
+        return data[index];
+    }
+    
+    const T& at(size_t index) const {
+        if (index >= size) {
+            INSTR_COUNT("pz9.at_out_of_range");
+            throw std::out_of_range("Индекс " + std::to_string(index) + 
+                                   " выходит за границы массива [0, " + 
+                                   std::to_string(size - 1) + "]");
+        }
+        return data[index];
+    }
+    
+    // Запись в файл формата ArrayFileHeader; открыть его, не читая
+    // в память, можно через MappedArray<T>::open
+    template<typename U = T>
+    typename std::enable_if<std::is_trivially_copyable<U>::value>::type
+    save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Не удалось открыть файл для записи: " + path);
+        }
+        char header[ArrayFileHeader::kSize];
+        ArrayFileHeader::encode(header, sizeof(T), size);
+        out.write(header, sizeof(header));
+        out.write(reinterpret_cast<const char*>(data), size * sizeof(T));
+        if (!out.flush()) {
+            throw std::runtime_error("Ошибка записи массива: " + path);
+        }
+    }
+    
+    // Массовые операции на общем пуле потоков (parallel.h). grain - элементов
+    // на задачу (0 - по умолчанию); массив короче двух задач обрабатывается
+    // в вызывающем потоке
+    template<typename Fn>
+    void transform(Fn fn, size_t grain = 0) {
+        parallelTransform(data, size, data, fn, grain);
+    }
+    
+    // Свёртка op от identity; для float/double результат не зависит от
+    // числа потоков (порядок сложения задан кусками по grain)
+    template<typename R, typename Op>
+    R reduce(R identity, Op op, size_t grain = 0) const {
+        return parallelReduce(data, size, identity, op, grain);
+    }
+    
+    // По возрастанию; целые - поразрядной сортировкой
+    void sort(size_t grain = 0) {
+        parallelSort(data, size, grain);
+    }
+    
+    const T& min() const {
+        return data[parallelMinMax(data, size).first];
+    }
+    
+    const T& max() const {
+        return data[parallelMinMax(data, size).second];
+    }
+    
+    template<typename Pred>
+    size_t countIf(Pred pred, size_t grain = 0) const {
+        return parallelCountIf(data, size, pred, grain);
+    }
+    
+    // Индекс первого элемента, для которого pred истинен, или getSize()
+    template<typename Pred>
+    size_t find(Pred pred, size_t grain = 0) const {
+        return parallelFind(data, size, pred, grain);
+    }
+    
+    // Сеттер с проверкой для числовых типов (специализация через SFINAE)
+    template<typename U = T>
+    typename std::enable_if<std::is_arithmetic<U>::value>::type
+    setWithCheck(size_t index, U value) {
+        // Для числовых типов можно добавить дополнительную проверку
+        // Например, проверку диапазона для целых чисел
+        if (index >= size) {
+            throw std::out_of_range("Индекс " + std::to_string(index) + 
+                                   " выходит за границы массива");
+        }
+        data[index] = value;
+    }
+    
+    // Перегрузка для нечисловых типов (просто сеттер без дополнительной проверки)
+    template<typename U = T>
+    typename std::enable_if<!std::is_arithmetic<U>::value>::type
+    setWithCheck(size_t index, const U& value) {
+        if (index >= size) {
+            throw std::out_of_range("Индекс " + std::to_string(index) + 
+                                   " выходит за границы массива");
+        }
+        data[index] = value;
+    }
+    
+    // Операция вывода
+    friend std::ostream& operator<<(std::ostream& os, const Array& arr) {
+        os << "[";
+        for (size_t i = 0; i < arr.size; i++) {
+            os << arr.data[i];
+            if (i < arr.size - 1) {
+                os << ", ";
+            }
+        }
+        os << "]";
+        return os;
+    }
+    
+    // Вычисление евклидова расстояния между массивами
+    template<typename U = T>
+    typename std::enable_if<std::is_arithmetic<U>::value, double>::type
+    static euclideanDistance(const Array<U, Alloc>& arr1, const Array<U, Alloc>& arr2) {
+        if (arr1.size != arr2.size) {
+            throw std::invalid_argument("Массивы должны иметь одинаковый размер: " + 
+                                       std::to_string(arr1.size) + " != " + 
+                                       std::to_string(arr2.size));
+        }
+        
+        return std::sqrt(squaredL2Distance(arr1, arr2));
+    }
+    
+    // Перегрузка для нечисловых типов
+    template<typename U = T>
+    typename std::enable_if<!std::is_arithmetic<U>::value, double>::type
+    static euclideanDistance(const Array<U, Alloc>& arr1, const Array<U, Alloc>& arr2) {
+        // Для нечисловых типов выбрасываем исключение
+        throw std::bad_typeid();
+    }
+    
+    // Остальные метрики для числовых типов (векторные ядра для float,
+    // double, int32_t и int8_t; float накапливается во float по блокам)
+    template<typename U = T>
+    typename std::enable_if<std::is_arithmetic<U>::value, double>::type
+    static squaredL2Distance(const Array<U, Alloc>& arr1, const Array<U, Alloc>& arr2) {
+        double sums[3];
+        computeSums<Metric::SquaredL2>(arr1, arr2, sums);
+        return sums[0];
+    }
+    
+    template<typename U = T>
+    typename std::enable_if<std::is_arithmetic<U>::value, double>::type
+    static l1Distance(const Array<U, Alloc>& arr1, const Array<U, Alloc>& arr2) {
+        double sums[3];
+        computeSums<Metric::L1>(arr1, arr2, sums);
+        return sums[0];
+    }
+    
+    template<typename U = T>
+    typename std::enable_if<std::is_arithmetic<U>::value, double>::type
+    static dotProduct(const Array<U, Alloc>& arr1, const Array<U, Alloc>& arr2) {
+        double sums[3];
+        computeSums<Metric::Dot>(arr1, arr2, sums);
+        return sums[0];
+    }
+    
+    // 1 - cos(угла между массивами); для нулевого массива - 1
+    template<typename U = T>
+    typename std::enable_if<std::is_arithmetic<U>::value, double>::type
+    static cosineDistance(const Array<U, Alloc>& arr1, const Array<U, Alloc>& arr2) {
+        double sums[3];
+        computeSums<Metric::Cosine>(arr1, arr2, sums);
+        if (sums[1] == 0.0 || sums[2] == 0.0) {
+            return 1.0;
+        }
+        return 1.0 - sums[0] / (std::sqrt(sums[1]) * std::sqrt(sums[2]));
+    }
+    
+private:
+    template<Metric M>
+    static void computeSums(const Array& arr1, const Array& arr2, double* sums) {
+        if (arr1.size != arr2.size) {
+            throw std::invalid_argument("Массивы должны иметь одинаковый размер: " + 
+                                       std::to_string(arr1.size) + " != " + 
+                                       std::to_string(arr2.size));
+        }
+        metricSums<T, M>(arr1.data, arr2.data, arr1.size, sums);
+    }
+    
+    // Записывает e[i] в data[i] блоками постоянной длины (их компилятор
+    // векторизует и при -O2). Зависимостей между итерациями нет (только
+    // одинаковые индексы), поэтому ivdep снимает проверки пересечения
+    // памяти, а большие массивы вычисляются кусками на пуле потоков
+    template<typename E>
+    void evaluate(const E& e) {
+        constexpr size_t kBlock = 16;
+        T* out = data;
+        parallelFor(size, [&](size_t begin, size_t end) {
+            size_t blocked = begin + (end - begin) / kBlock * kBlock;
+            for (size_t i = begin; i < blocked; i += kBlock) {
+#pragma GCC ivdep
+                for (size_t j = 0; j < kBlock; j++) {
+                    out[i + j] = static_cast<T>(e[i + j]);
+                }
+            }
+            for (size_t i = blocked; i < end; i++) {
+                out[i] = static_cast<T>(e[i]);
+            }
+        });
+    }
+    
+    // Копия other в памяти allocator
+    Array(size_t size, const Array& other, const Alloc& allocator) 
+        : alloc(allocator), data(nullptr), size(size) {
+        if (size > 0) {
+            data = allocate(size);
+            copyFrom(other);
+        }
+    }
+    
+    T* allocate(size_t n) {
+        if constexpr (IsPmrAllocator<Alloc>::value) {
+            return static_cast<T*>(alloc.resource()->allocate(n * sizeof(T), kPmrAlignment));
+        } else {
+            return Traits::allocate(alloc, n);
+        }
+    }
+    
+    void deallocate(T* p, size_t n) {
+        if constexpr (IsPmrAllocator<Alloc>::value) {
+            alloc.resource()->deallocate(p, n * sizeof(T), kPmrAlignment);
+        } else {
+            Traits::deallocate(alloc, p, n);
+        }
+    }
+    
+    // Создаёт элементы construct(slot, i) по порядку; при исключении уже
+    // созданные разрушаются, память возвращается
+    template<typename Construct>
+    void constructEach(Construct construct) {
+        size_t i = 0;
+        try {
+            for (; i < size; i++) {
+                construct(data + i, i);
+            }
+        } catch (...) {
+            for (size_t j = i; j > 0; j--) {
+                data[j - 1].~T();
+            }
+            deallocate(data, size);
+            data = nullptr;
+            throw;
+        }
+    }
+    
+    // Заполняет только что выделенный data копией other (size элементов)
+    void copyFrom(const Array& other) {
+        if (std::is_trivially_copyable<T>::value) {
+            std::memcpy(static_cast<void*>(data), other.data, size * sizeof(T));
+        } else {
+            constructEach([&](T* slot, size_t i) { ::new (static_cast<void*>(slot)) T(other.data[i]); });
+        }
+    }
+    
+    void release() {
+        if (data) {
+            if (!std::is_trivially_destructible<T>::value) {
+                for (size_t i = 0; i < size; i++) {
+                    data[i].~T();
+                }
+            }
+            deallocate(data, size);
+            data = nullptr;
+        }
+    }
+    
+    // Обмен буфером с временной копией; аллокатор переходит вместе с
+    // буфером, только если он распространяется при копирующем присваивании
+    // (pmr-аллокатор не присваивается вовсе)
+    void swapStorage(Array& other) {
+        if constexpr (Traits::propagate_on_container_copy_assignment::value) {
+            std::swap(alloc, other.alloc);
+        }
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+    }
+};
+
+// Массив строк: все символы лежат подряд в одной арене, на элемент -
+// 8 байт (смещение и длина в арене) вместо std::string с отдельной
+// кучей. Чтение отдаёт std::string_view, копирование массива - два
+// memcpy (арена и таблица смещений), вывод и обход идут по арене подряд.
+//
+// Запись новой строки дописывает её в конец арены (или поверх старой,
+// если та не короче); место перезаписанных строк собирается compact(),
+// который вызывается сам, когда мусора в арене больше, чем живых данных
+// (при интернировании - по верхней оценке мусора).
+// С setInterning(true) одинаковые строки хранятся в арене один раз.
+// string_view, полученные из массива, действительны до его следующего
+// изменения. Арена ограничена 4 ГиБ (смещения 32-битные).
+template<typename Alloc>
+class Array<std::string, Alloc> {
+private:
+    struct Slot {
+        uint32_t offset;
+        uint32_t length;
+    };
+    
+    using Traits = std::allocator_traits<Alloc>;
+    using CharAlloc = typename Traits::template rebind_alloc<char>;
+    using SlotAlloc = typename Traits::template rebind_alloc<Slot>;
+    
+    std::vector<char, CharAlloc> arena;
+    std::vector<Slot, SlotAlloc> slots;
+    size_t garbage = 0;  // байт арены, на которые не ссылается ни один элемент
+    bool interning = false;
+    std::unordered_multimap<size_t, Slot> interned;  // хеш строки -> её место в арене
+    
+public:
+    // Ссылка на элемент для arr[i] = "..." (строку нельзя изменить на месте)
+    class Reference {
+    public:
+        Reference& operator=(std::string_view value) {
+            owner.assign(index, value);
+            return *this;
+        }
+        
+        Reference& operator=(const Reference& other) {
+            return *this = static_cast<std::string_view>(other);
+        }
+        
+        operator std::string_view() const {
+            return static_cast<const Array&>(owner)[index];
+        }
+        
+        friend std::ostream& operator<<(std::ostream& os, const Reference& ref) {
+            return os << static_cast<std::string_view>(ref);
+        }
+        
+    private:
+        friend class Array;
+        Reference(Array& owner, size_t index) : owner(owner), index(index) {}
+        
+        Array& owner;
+        size_t index;
+    };
+    
+    // Конструктор: size пустых строк
+    explicit Array(size_t size, const Alloc& alloc = Alloc()) 
+        : arena(CharAlloc(alloc)), slots(size, Slot{0, 0}, SlotAlloc(alloc)) {
+        if (size <= 0) {
+            throw std::invalid_argument("Размер массива должен быть положительным числом");
+        }
+    }
+    
+    // Получение размера
+    size_t getSize() const {
+        return slots.size();
+    }
+    
+    // Оператор [] для доступа к элементам (без проверки границ)
+    std::string_view operator[](size_t index) const {
+        const Slot& slot = slots[index];
+        return std::string_view(arena.data() + slot.offset, slot.length);
+    }
+    
+    Reference operator[](size_t index) {
+        return Reference(*this, index);
+    }
+    
+    // Безопасный доступ с проверкой границ
+    std::string_view at(size_t index) const {
+        checkIndex(index);
+        return (*this)[index];
+    }
+    
+    void setWithCheck(size_t index, std::string_view value) {
+        if (index >= slots.size()) {
+            throw std::out_of_range("Индекс " + std::to_string(index) + 
+                                   " выходит за границы массива");
+        }
+        assign(index, value);
+    }
+    
+    // Хранить одинаковые строки один раз. Включение индексирует уже
+    // записанные строки; выключение уплотняет арену, чтобы у каждого
+    // элемента снова были свои байты (иначе запись на место старой строки
+    // изменила бы и все равные ей элементы)
+    void setInterning(bool enabled) {
+        bool wasInterning = interning;
+        interning = enabled;
+        interned.clear();
+        if (!enabled && wasInterning) {
+            compact();
+        }
+        if (enabled) {
+            for (const Slot& slot : slots) {
+                if (slot.length > 0 && !findInterned(view(slot))) {
+                    interned.emplace(std::hash<std::string_view>()(view(slot)), slot);
+                }
+            }
+        }
+    }
+    
+    bool isInterning() const {
+        return interning;
+    }
+    
+    // Байт занято в арене (включая ещё не собранный мусор)
+    size_t getArenaSize() const {
+        return arena.size();
+    }
+    
+    // Переписывает арену без мусора, в порядке элементов
+    void compact() {
+        std::vector<char, CharAlloc> packed(arena.get_allocator());
+        std::unordered_multimap<size_t, Slot> index;
+        packed.reserve(arena.size() - std::min(garbage, arena.size()));
+        for (Slot& slot : slots) {
+            std::string_view value = view(slot);
+            if (interning && slot.length > 0) {
+                size_t hash = std::hash<std::string_view>()(value);
+                bool found = false;
+                auto range = index.equal_range(hash);
+                for (auto it = range.first; it != range.second; ++it) {
+                    if (std::string_view(packed.data() + it->second.offset, it->second.length) == value) {
+                        slot = it->second;
+                        found = true;
+                        break;
+                    }
+                }
+                if (found) {
+                    continue;
+                }
+                Slot moved{static_cast<uint32_t>(packed.size()), slot.length};
+                index.emplace(hash, moved);
+                packed.insert(packed.end(), value.begin(), value.end());
+                slot = moved;
+            } else {
+                uint32_t offset = static_cast<uint32_t>(packed.size());
+                packed.insert(packed.end(), value.begin(), value.end());
+                slot.offset = offset;
+            }
+        }
+        arena.swap(packed);
+        interned.swap(index);
+        garbage = 0;
+    }
+    
+    // Операция вывода: проход по арене без копирования строк
+    friend std::ostream& operator<<(std::ostream& os, const Array& arr) {
+        os << "[";
+        for (size_t i = 0; i < arr.slots.size(); i++) {
+            os << arr[i];
+            if (i < arr.slots.size() - 1) {
+                os << ", ";
+            }
+        }
+        os << "]";
+        return os;
+    }
+    
+    // Расстояние для строк не определено
+    static double euclideanDistance(const Array&, const Array&) {
+        throw std::bad_typeid();
+    }
+    
+private:
+    static constexpr size_t kMaxArena = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t kCompactMinimum = 4096;  // мелкие арены не уплотняем
+    
+    std::string_view view(const Slot& slot) const {
+        return std::string_view(arena.data() + slot.offset, slot.length);
+    }
+    
+    void checkIndex(size_t index) const {
+        if (index >= slots.size()) {
+            INSTR_COUNT("pz9.at_out_of_range");
+            throw std::out_of_range("Индекс " + std::to_string(index) + 
+                                   " выходит за границы массива [0, " + 
+                                   std::to_string(slots.size() - 1) + "]");
+        }
+    }
+    
+    const Slot* findInterned(std::string_view value) const {
+        auto range = interned.equal_range(std::hash<std::string_view>()(value));
+        for (auto it = range.first; it != range.second; ++it) {
+            if (view(it->second) == value) {
+                return &it->second;
+            }
+        }
+        return nullptr;
+    }
+    
+    void assign(size_t index, std::string_view value) {
+        Slot& slot = slots[index];
+        if (interning) {
+            // Старая строка может быть общей с другими элементами, поэтому
+            // мусор считается с запасом: compact() пересчитает его точно
+            garbage += slot.length;
+            if (const Slot* existing = findInterned(value)) {
+                slot = *existing;
+                return;
+            }
+        } else if (value.size() <= slot.length) {
+            // Помещается на место старой строки (memmove: value может
+            // указывать в эту же арену)
+            std::memmove(arena.data() + slot.offset, value.data(), value.size());
+            garbage += slot.length - value.size();
+            slot.length = static_cast<uint32_t>(value.size());
+            return;
+        } else {
+            garbage += slot.length;
+        }
+        slot = Slot{0, 0};  // старое значение не должно пережить compact()
+        
+        // value может указывать в арену, которая сейчас перевыделится
+        std::string copy;
+        if (value.data() >= arena.data() && value.data() < arena.data() + arena.size()) {
+            copy.assign(value);
+            value = copy;
+        }
+        if (garbage > arena.size() / 2 && arena.size() > kCompactMinimum) {
+            compact();
+        }
+        if (value.size() > kMaxArena - arena.size()) {
+            compact();
+            if (value.size() > kMaxArena - arena.size()) {
+                throw std::length_error("Арена строк превысила 4 ГиБ");
+            }
+        }
+        
+        Slot added{static_cast<uint32_t>(arena.size()), static_cast<uint32_t>(value.size())};
+        arena.insert(arena.end(), value.begin(), value.end());
+        slots[index] = added;
+        if (interning && added.length > 0) {
+            interned.emplace(std::hash<std::string_view>()(value), added);
+        }
+    }
+};
+
+// Доступ к файлу MappedArray и подсказка ядру о порядке обращений
+// (madvise): Sequential - читать вперёд, Random - не читать лишнего
+enum class MapMode { ReadOnly, ReadWrite };
+enum class MapAdvice { Normal, Sequential, Random };
+
+// Массив в файле формата ArrayFileHeader, отображённом в память. Элементы
+// читаются с диска страницами при первом обращении, поэтому открытие не
+// зависит от размера файла, а сам массив может быть больше оперативной
+// памяти. Полные проходы (save, метрики) идут окнами, и у больших массивов
+// пройденные окна сразу выгружаются (evict), так что резидентная память
+// не растёт с размером файла.
+// ReadWrite: записи через operator[]/at попадают в файл, flush() дожидается
+// записи на диск. ReadOnly: присваивание элементу бросает std::logic_error.
+// Элементы хранятся в порядке байт этой машины.
+// Без mmap (не POSIX) файл читается в память целиком, а ReadWrite
+// записывается обратно в flush() и при уничтожении.
+template<typename T>
+class MappedArray : public ArrayExpr<MappedArray<T>> {
+    static_assert(std::is_trivially_copyable<T>::value, "Элементы MappedArray хранятся как байты файла");
+    
+public:
+    // Новый файл из size нулевых элементов; место на диске занимается
+    // по мере записи
+    static MappedArray create(const std::string& path, size_t size) {
+        if (size <= 0) {
+            throw std::invalid_argument("Размер массива должен быть положительным числом");
+        }
+        if (size > (std::numeric_limits<size_t>::max() - ArrayFileHeader::kSize) / sizeof(T)) {
+            throw std::length_error("Слишком большой размер массива");
+        }
+        char header[ArrayFileHeader::kSize];
+        ArrayFileHeader::encode(header, sizeof(T), size);
+        size_t bytes = ArrayFileHeader::kSize + size * sizeof(T);
+#ifdef PZ9_HAS_MMAP
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Не удалось открыть файл для записи: " + path);
+        }
+        bool written = ::ftruncate(fd, static_cast<off_t>(bytes)) == 0 && 
+                       ::pwrite(fd, header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+        ::close(fd);
+        if (!written) {
+            throw std::runtime_error("Ошибка записи массива: " + path);
+        }
+#else
+        std::ofstream out(path, std::ios::binary);
+        out.write(header, sizeof(header));
+        std::vector<char> zeros(1 << 20);
+        for (size_t left = bytes - sizeof(header); left > 0 && out; ) {
+            size_t n = std::min(left, zeros.size());
+            out.write(zeros.data(), n);
+            left -= n;
+        }
+        if (!out.flush()) {
+            throw std::runtime_error("Ошибка записи массива: " + path);
+        }
+#endif
+        return open(path, MapMode::ReadWrite);
+    }
+    
+    static MappedArray open(const std::string& path, MapMode mode = MapMode::ReadOnly, 
+                            MapAdvice advice = MapAdvice::Normal) {
+        MappedArray arr;
+        arr.mode = mode;
+#ifdef PZ9_HAS_MMAP
+        int fd = ::open(path.c_str(), mode == MapMode::ReadWrite ? O_RDWR : O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Не удалось открыть файл: " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < ArrayFileHeader::kSize) {
+            ::close(fd);
+            throw std::runtime_error("Неверный формат файла массива: " + path);
+        }
+        int protection = mode == MapMode::ReadWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+        void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), protection, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("Не удалось отобразить файл: " + path);
+        }
+        arr.base = static_cast<char*>(p);
+        arr.mappedBytes = static_cast<size_t>(st.st_size);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            throw std::runtime_error("Не удалось открыть файл: " + path);
+        }
+        arr.copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        arr.base = arr.copy.data();
+        arr.mappedBytes = arr.copy.size();
+        arr.path = path;
+#endif
+        arr.size = ArrayFileHeader::decode(arr.base, arr.mappedBytes, sizeof(T), path);
+        arr.data = reinterpret_cast<T*>(arr.base + ArrayFileHeader::kSize);
+        arr.advise(advice);
+        return arr;
+    }
+    
+    MappedArray(MappedArray&& other) noexcept {
+        swap(other);
+    }
+    
+    MappedArray& operator=(MappedArray&& other) noexcept {
+        if (this != &other) {
+            MappedArray old(std::move(other));
+            swap(old);
+        }
+        return *this;
+    }
+    
+    MappedArray(const MappedArray&) = delete;
+    MappedArray& operator=(const MappedArray&) = delete;
+    
+    ~MappedArray() {
+        release();
+    }
+    
+    size_t getSize() const {
+        return size;
+    }
+    
+    MapMode getMode() const {
+        return mode;
+    }
+    
+    // Элемент для записи: чтение через него работает в любом режиме,
+    // присваивание в ReadOnly бросает std::logic_error
+    class Reference {
+    public:
+        Reference& operator=(const T& value) {
+            owner.requireWritable();
+            owner.data[index] = value;
+            return *this;
+        }
+        
+        Reference& operator=(const Reference& other) {
+            return *this = static_cast<T>(other);
+        }
+        
+        Reference& operator+=(const T& value) { return *this = static_cast<T>(*this) + value; }
+        Reference& operator-=(const T& value) { return *this = static_cast<T>(*this) - value; }
+        Reference& operator*=(const T& value) { return *this = static_cast<T>(*this) * value; }
+        Reference& operator/=(const T& value) { return *this = static_cast<T>(*this) / value; }
+        
+        operator T() const {
+            return owner.data[index];
+        }
+        
+        friend std::ostream& operator<<(std::ostream& os, const Reference& ref) {
+            return os << static_cast<T>(ref);
+        }
+        
+    private:
+        friend class MappedArray;
+        Reference(MappedArray& owner, size_t index) : owner(owner), index(index) {}
+        
+        MappedArray& owner;
+        size_t index;
+    };
+    
+    // Оператор [] для доступа к элементам (без проверки границ)
+    const T& operator[](size_t index) const {
+        return data[index];
+    }
+    
+    Reference operator[](size_t index) {
+        return Reference(*this, index);
+    }
+    
+    // Безопасный доступ с проверкой границ
+    const T& at(size_t index) const {
+        checkIndex(index);
+        return data[index];
+    }
+    
+    Reference at(size_t index) {
+        checkIndex(index);
+        return Reference(*this, index);
+    }
+    
+    void advise(MapAdvice advice) {
+#ifdef PZ9_HAS_MMAP
+        int flag = advice == MapAdvice::Sequential ? MADV_SEQUENTIAL 
+                 : advice == MapAdvice::Random ? MADV_RANDOM : MADV_NORMAL;
+        ::madvise(base, mappedBytes, flag);
+#else
+        (void)advice;
+#endif
+    }
+    
+    // Убрать страницы элементов [first, last) из памяти процесса. Данные
+    // остаются в файле (изменённые - в страничном кэше до записи на диск)
+    // и подгрузятся снова при обращении
+    void evict(size_t first, size_t last) const {
+#ifdef PZ9_HAS_MMAP
+        static const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        last = std::min(last, size);
+        if (first >= last) {
+            return;
+        }
+        size_t begin = (ArrayFileHeader::kSize + first * sizeof(T)) / page * page;
+        size_t end = ArrayFileHeader::kSize + last * sizeof(T);
+        ::madvise(base + begin, end - begin, MADV_DONTNEED);
+#else
+        (void)first;
+        (void)last;
+#endif
+    }
+    
+    // Дождаться записи изменённых элементов на диск (ReadWrite)
+    void flush() {
+        if (mode != MapMode::ReadWrite) {
+            return;
+        }
+#ifdef PZ9_HAS_MMAP
+        if (::msync(base, mappedBytes, MS_SYNC) != 0) {
+            throw std::runtime_error("Ошибка записи массива на диск");
+        }
+#else
+        std::ofstream out(path, std::ios::binary);
+        out.write(copy.data(), copy.size());
+        if (!out.flush()) {
+            throw std::runtime_error("Ошибка записи массива: " + path);
+        }
+#endif
+    }
+    
+    // Копия в новый файл того же формата, окнами
+    void save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Не удалось открыть файл для записи: " + path);
+        }
+        out.write(base, ArrayFileHeader::kSize);
+        forEachWindow([&](size_t first, size_t last) {
+            out.write(reinterpret_cast<const char*>(data + first), (last - first) * sizeof(T));
+        });
+        if (!out.flush()) {
+            throw std::runtime_error("Ошибка записи массива: " + path);
+        }
+    }
+    
+    // Метрики как у Array (те же векторные ядра), по окнам
+    template<typename U = T>
+    typename std::enable_if<std::is_arithmetic<U>::value, double>::type
+    static euclideanDistance(const MappedArray& arr1, const MappedArray& arr2) {
+        return std::sqrt(squaredL2Distance(arr1, arr2));
+    }
+    
+    template<typename U = T>
+    typename std::enable_if<std::is_arithmetic<U>::value, double>::type
+    static squaredL2Distance(const MappedArray& arr1, const MappedArray& arr2) {
+        if (arr1.size != arr2.size) {
+            throw std::invalid_argument("Массивы должны иметь одинаковый размер: " + 
+                                       std::to_string(arr1.size) + " != " + 
+                                       std::to_string(arr2.size));
+        }
+        double total = 0.0;
+        arr1.forEachWindow([&](size_t first, size_t last) {
+            double sums[3];
+            metricSums<T, Metric::SquaredL2>(arr1.data + first, arr2.data + first, last - first, sums);
+            total += sums[0];
+            if (&arr2 != &arr1 && arr2.size * sizeof(T) > kResidentBytes) {
+                arr2.evict(first, last);
+            }
+        });
+        return total;
+    }
+    
+private:
+    // Полные проходы идут окнами по kWindowBytes; массивы больше
+    // kResidentBytes выгружают пройденные окна
+    static constexpr size_t kWindowBytes = size_t(16) << 20;
+    static constexpr size_t kResidentBytes = size_t(256) << 20;
+    
+    MappedArray() = default;
+    
+    template<typename Body>
+    void forEachWindow(Body body) const {
+        size_t window = std::max<size_t>(1, kWindowBytes / sizeof(T));
+        bool evictBehind = size * sizeof(T) > kResidentBytes;
+        for (size_t first = 0; first < size; first += window) {
+            size_t last = std::min(size, first + window);
+            body(first, last);
+            if (evictBehind) {
+                evict(first, last);
+            }
+        }
+    }
+    
+    void checkIndex(size_t index) const {
+        if (index >= size) {
+            INSTR_COUNT("pz9.at_out_of_range");
+            throw std::out_of_range("Индекс " + std::to_string(index) + 
+                                   " выходит за границы массива [0, " + 
+                                   std::to_string(size - 1) + "]");
+        }
+    }
+    
+    void requireWritable() const {
+        if (mode != MapMode::ReadWrite) {
+            throw std::logic_error("Массив открыт только для чтения");
+        }
+    }
+    
+    void swap(MappedArray& other) noexcept {
+        std::swap(base, other.base);
+        std::swap(mappedBytes, other.mappedBytes);
+        std::swap(data, other.data);
+        std::swap(size, other.size);
+        std::swap(mode, other.mode);
+#ifndef PZ9_HAS_MMAP
+        copy.swap(other.copy);
+        path.swap(other.path);
+#endif
+    }
+    
+    void release() {
+        if (!base) {
+            return;
+        }
+#ifdef PZ9_HAS_MMAP
+        ::munmap(base, mappedBytes);
+#else
+        try {
+            flush();
+        } catch (const std::exception& e) {
+            std::cerr << "Ошибка записи массива: " << e.what() << std::endl;
+        }
+#endif
+        base = nullptr;
+    }
+    
+    char* base = nullptr;       // начало отображения (заголовок)
+    size_t mappedBytes = 0;
+    T* data = nullptr;          // элементы после заголовка
+    size_t size = 0;
+    MapMode mode = MapMode::ReadOnly;
+#ifndef PZ9_HAS_MMAP
+    std::vector<char> copy;     // содержимое файла без mmap
+    std::string path;
+#endif
+};
+
+// Специальный сеттер с проверкой диапазона для числовых значений
+template<typename T>
+class ArrayRangeChecker {
+public:
+    // Проверка и установка значения с проверкой диапазона
+    template<typename U = T>
+    static typename std::enable_if<std::is_arithmetic<U>::value>::type
+    setWithRangeCheck(Array<U>& arr, size_t index, U value, U minVal, U maxVal) {
+        if (value < minVal || value > maxVal) {
+            throw std::invalid_argument("Значение " + std::to_string(value) + 
+                                       " должно быть в диапазоне [" + 
+                                       std::to_string(minVal) + ", " + 
+                                       std::to_string(maxVal) + "]");
+        }
+        arr.setWithCheck(index, value);
+    }
+    
+    // Для нечисловых типов - просто установка (без проверки диапазона)
+    template<typename U = T>
+    static typename std::enable_if<!std::is_arithmetic<U>::value>::type
+    setWithRangeCheck(Array<U>& arr, size_t index, const U& value, U minVal, U maxVal) {
+        // Для нечисловых типов игнорируем minVal и maxVal
+        arr.setWithCheck(index, value);
+    }
+};
+
+// Помещается ли диапазон [lo, hi] в целый тип U. Сравнения идут через
+// intmax_t/uintmax_t, чтобы не смешивать знаковые и беззнаковые типы.
+template<typename U, typename T>
+constexpr bool rangeFits(T lo, T hi) {
+    bool lowOk = !(lo < T()) ||
+                 (std::is_signed<U>::value &&
+                  static_cast<intmax_t>(lo) >= static_cast<intmax_t>(std::numeric_limits<U>::min()));
+    bool highOk = hi < T() ||
+                  static_cast<uintmax_t>(hi) <= static_cast<uintmax_t>(std::numeric_limits<U>::max());
+    return lowOk && highOk;
+}
+
+// Самый узкий тип хранения для значений из [Min, Max]
+template<typename T, T Min, T Max>
+struct BoundedStorage {
+    using type =
+        typename std::conditional<rangeFits<int8_t>(Min, Max), int8_t,
+        typename std::conditional<rangeFits<uint8_t>(Min, Max), uint8_t,
+        typename std::conditional<rangeFits<int16_t>(Min, Max), int16_t,
+        typename std::conditional<rangeFits<uint16_t>(Min, Max), uint16_t,
+        typename std::conditional<rangeFits<int32_t>(Min, Max), int32_t,
+        typename std::conditional<rangeFits<uint32_t>(Min, Max), uint32_t,
+        T>::type>::type>::type>::type>::type>::type;
+};
+
+// Массив значений из диапазона [Min, Max], известного при компиляции.
+// Элементы хранятся в самом узком подходящем типе (BoundedArray<int, -100, 100>
+// занимает байт на элемент), наружу отдаются как T.
+// Проверки: set(i, value) - во время выполнения; set<V>(i) - при компиляции;
+// set(i, Value) - значение уже проверено при создании Value (в constexpr
+// контексте - компилятором), поэтому запись не проверяет его повторно.
+template<typename T, T Min, T Max>
+class BoundedArray {
+    static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value,
+                  "BoundedArray поддерживает только целые типы");
+    static_assert(Min <= Max, "Пустой диапазон BoundedArray");
+    
+public:
+    using Storage = typename BoundedStorage<T, Min, Max>::type;
+    
+    static constexpr bool isValid(T value) {
+        return value >= Min && value <= Max;
+    }
+    
+    // Проверенное значение. В constexpr контексте значение вне диапазона -
+    // ошибка компиляции, во время выполнения - std::invalid_argument.
+    class Value {
+    public:
+        constexpr Value(T value)
+            : value(isValid(value) ? value : (throw std::invalid_argument(rangeMessage(value)), value)) {}
+        
+        constexpr T get() const {
+            return value;
+        }
+        
+    private:
+        T value;
+    };
+    
+    // Конструктор: элементы равны 0, если он в диапазоне, иначе Min
+    explicit BoundedArray(size_t size) : size(size) {
+        if (size <= 0) {
+            throw std::invalid_argument("Размер массива должен быть положительным числом");
+        }
+        data = new Storage[size];
+        for (size_t i = 0; i < size; i++) {
+            data[i] = static_cast<Storage>(kDefault);
+        }
+    }
+    
+    // Деструктор
+    ~BoundedArray() {
+        delete[] data;
+    }
+    
+    // Конструктор копирования (значения уже проверены)
+    BoundedArray(const BoundedArray& other) : size(other.size) {
+        data = new Storage[size];
+        std::copy(other.data, other.data + size, data);
+    }
+    
+    // Оператор присваивания
+    BoundedArray& operator=(const BoundedArray& other) {
+        if (this != &other) {
+            Storage* fresh = new Storage[other.size];
+            std::copy(other.data, other.data + other.size, fresh);
+            delete[] data;
+            data = fresh;
+            size = other.size;
+        }
+        return *this;
+    }
+    
+    size_t getSize() const {
+        return size;
+    }
+    
+    // Чтение без проверки границ (как Array::operator[])
+    T operator[](size_t index) const {
+        return static_cast<T>(data[index]);
+    }
+    
+    T at(size_t index) const {
+        checkIndex(index);
+        return static_cast<T>(data[index]);
+    }
+    
+    // Запись с проверкой значения. При константном value проверка
+    // сворачивается компилятором после встраивания.
+    void set(size_t index, T value) {
+        checkIndex(index);
+        if (!isValid(value)) {
+            INSTR_COUNT("pz9.bounded_invalid_value");
+            throw std::invalid_argument(rangeMessage(value));
+        }
+        data[index] = static_cast<Storage>(value);
+    }
+    
+    // Запись проверенного значения: проверяется только индекс
+    void set(size_t index, Value value) {
+        checkIndex(index);
+        data[index] = static_cast<Storage>(value.get());
+    }
+    
+    // Запись константы: диапазон проверяется при компиляции
+    template<T V>
+    void set(size_t index) {
+        static_assert(isValid(V), "Значение вне диапазона BoundedArray");
+        checkIndex(index);
+        data[index] = static_cast<Storage>(V);
+    }
+    
+    // Операция вывода
+    friend std::ostream& operator<<(std::ostream& os, const BoundedArray& arr) {
+        os << "[";
+        for (size_t i = 0; i < arr.size; i++) {
+            os << static_cast<T>(arr.data[i]);
+            if (i < arr.size - 1) {
+                os << ", ";
+            }
+        }
+        os << "]";
+        return os;
+    }
+    
+private:
+    static constexpr T kDefault = isValid(T()) ? T() : Min;
+    
+    static std::string rangeMessage(T value) {
+        return "Значение " + std::to_string(value) + 
+               " должно быть в диапазоне [" + 
+               std::to_string(Min) + ", " + 
+               std::to_string(Max) + "]";
+    }
+    
+    void checkIndex(size_t index) const {
+        if (index >= size) {
+            INSTR_COUNT("pz9.bounded_out_of_range");
+            throw std::out_of_range("Индекс " + std::to_string(index) + 
+                                   " выходит за границы массива");
+        }
+    }
+    
+    Storage* data;
+    size_t size;
+};
+
+// Сосед из поиска ближайших: номер строки набора и евклидово расстояние.
+// Порядок - по расстоянию, при равенстве - по номеру.
+struct Neighbor {
+    size_t index;
+    double distance;
+    
+    bool operator<(const Neighbor& other) const {
+        return distance < other.distance || 
+               (distance == other.distance && index < other.index);
+    }
+};
+
+// Набор массивов одной длины, уложенных подряд (строка за строкой), для
+// пакетного расчёта евклидовых расстояний: один запрос против всего набора
+// и матрица расстояний между двумя наборами.
+//
+// Матрица считается через |q - x|² = |q|² + |x|² - 2 q·x: квадраты норм
+// строк хранятся заранее, а скалярные произведения идут как умножение
+// матриц - блок строк-запросов (около 128 КБ, остаётся в L2) проходит по
+// панелям набора (panelDots). Блоки запросов распределяются между потоками.
+// Для почти совпадающих векторов формула теряет точность (разность
+// близких чисел); отрицательные результаты округления обнуляются.
+template<typename T>
+class ArrayBatch {
+    static_assert(std::is_arithmetic<T>::value, "ArrayBatch хранит только числовые типы");
+    
+public:
+    explicit ArrayBatch(size_t dimension) : dimension(dimension) {
+        if (dimension == 0) {
+            throw std::invalid_argument("Размер массива должен быть положительным числом");
+        }
+    }
+    
+    explicit ArrayBatch(const std::vector<Array<T>>& arrays) 
+        : ArrayBatch(dimensionOf(arrays)) {
+        values.reserve(arrays.size() * dimension);
+        norms.reserve(arrays.size());
+        for (const Array<T>& arr : arrays) {
+            add(arr);
+        }
+    }
+    
+    void add(const Array<T>& arr) {
+        if (arr.getSize() != dimension) {
+            throw std::invalid_argument("Массивы должны иметь одинаковый размер: " + 
+                                       std::to_string(arr.getSize()) + " != " + 
+                                       std::to_string(dimension));
+        }
+        for (size_t i = 0; i < dimension; i++) {
+            values.push_back(arr[i]);
+        }
+        const T* added = row(norms.size());
+        double sums[3];
+        metricSums<T, Metric::Dot>(added, added, dimension, sums);
+        norms.push_back(sums[0]);
+    }
+    
+    size_t getSize() const {
+        return norms.size();
+    }
+    
+    size_t getDimension() const {
+        return dimension;
+    }
+    
+    const T* row(size_t index) const {
+        return values.data() + index * dimension;
+    }
+    
+    // Расстояния от query до каждой строки набора
+    std::vector<double> distancesTo(const Array<T>& query, ThreadPool* pool = nullptr) const {
+        checkDimension(query.getSize());
+        std::vector<double> result(getSize());
+        const T* q = &query[0];
+        parallelFor(getSize(), [&](size_t begin, size_t end) {
+            for (size_t j = begin; j < end; j++) {
+                double sums[3];
+                metricSums<T, Metric::SquaredL2>(q, row(j), dimension, sums);
+                result[j] = std::sqrt(sums[0]);
+            }
+        }, kRowBlock, pool);
+        return result;
+    }
+    
+    // Для каждой строки queries вызывает visit(номер, расстояния), где
+    // расстояния - getSize() значений до строк этого набора. visit
+    // вызывается из рабочих потоков, в порядке не по номерам.
+    template<typename Visitor>
+    void forEachDistanceRow(const ArrayBatch& queries, Visitor visit, ThreadPool* pool = nullptr) const {
+        checkDimension(queries.dimension);
+        size_t n = getSize();
+        size_t block = queryBlockRows();
+        std::vector<T> panels = packPanels();
+        size_t panelCount = panels.size() / (kPanelCols * dimension);
+        
+        parallelFor(queries.getSize(), [&](size_t begin, size_t end) {
+            // Буфер на вызов и кусок, не на поток: потоки пула живут до
+            // конца процесса и держали бы его всё это время
+            std::vector<double> distances((end - begin) * n);
+            
+            // Панель (kPanelCols строк) остаётся в L1, пока по ней проходят
+            // все группы запросов блока
+            for (size_t p = 0; p < panelCount; p++) {
+                const T* panel = panels.data() + p * kPanelCols * dimension;
+                size_t cols = std::min<size_t>(kPanelCols, n - p * kPanelCols);
+                for (size_t g = begin; g < end; g += kDotRows) {
+                    // Неполную последнюю группу добиваем повтором последней строки
+                    const T* q[kDotRows];
+                    for (int r = 0; r < kDotRows; r++) {
+                        q[r] = queries.row(std::min(g + r, end - 1));
+                    }
+                    double dots[kDotRows * kPanelCols];
+                    panelDots(q, panel, dimension, dots);
+                    
+                    for (size_t r = 0; r < kDotRows && g + r < end; r++) {
+                        double* out = distances.data() + (g + r - begin) * n + p * kPanelCols;
+                        const double* rowNorms = norms.data() + p * kPanelCols;
+                        for (size_t c = 0; c < cols; c++) {
+                            double d2 = queries.norms[g + r] + rowNorms[c] - 2.0 * dots[r * kPanelCols + c];
+                            out[c] = d2 > 0.0 ? std::sqrt(d2) : 0.0;
+                        }
+                    }
+                }
+            }
+            
+            for (size_t i = begin; i < end; i++) {
+                visit(i, distances.data() + (i - begin) * n);
+            }
+        }, block, pool);
+    }
+    
+    // Матрица queries.getSize() x getSize() (по строкам)
+    std::vector<double> distanceMatrix(const ArrayBatch& queries, ThreadPool* pool = nullptr) const {
+        size_t n = getSize();
+        std::vector<double> result(queries.getSize() * n);
+        forEachDistanceRow(queries, [&](size_t i, const double* distances) {
+            std::copy(distances, distances + n, result.begin() + i * n);
+        }, pool);
+        return result;
+    }
+    
+    // Попарные расстояния внутри набора
+    std::vector<double> pairwiseDistances(ThreadPool* pool = nullptr) const {
+        std::vector<double> result = distanceMatrix(*this, pool);
+        for (size_t i = 0; i < getSize(); i++) {
+            result[i * getSize() + i] = 0.0;
+        }
+        return result;
+    }
+    
+    // k ближайших к query строк набора по возрастанию (расстояние, номер).
+    // Результат совпадает с полным перебором через euclideanDistance и
+    // сортировкой, но кандидат отбрасывается, как только частичная сумма
+    // квадратов по первым kPruneChunk*m элементам превысит текущее k-е
+    // расстояние; полностью считаются только попадающие в ответ строки.
+    std::vector<Neighbor> nearest(const Array<T>& query, size_t k, ThreadPool* pool = nullptr) const {
+        checkDimension(query.getSize());
+        k = std::min(k, getSize());
+        const T* q = &query[0];
+        
+        // Каждый блок строк ищет свои k лучших, потом списки сливаются
+        size_t blocks = (getSize() + kRowBlock - 1) / kRowBlock;
+        std::vector<std::vector<Neighbor>> partial(blocks);
+        parallelFor(getSize(), [&](size_t begin, size_t end) {
+            std::vector<Neighbor>& heap = partial[begin / kRowBlock];
+            for (size_t j = begin; j < end; j++) {
+                offerCandidate(q, j, k, heap);
+            }
+        }, kRowBlock, pool);
+        
+        std::vector<Neighbor> result;
+        for (const std::vector<Neighbor>& heap : partial) {
+            result.insert(result.end(), heap.begin(), heap.end());
+        }
+        std::sort(result.begin(), result.end());
+        result.resize(k);
+        return result;
+    }
+    
+    // nearest для каждой строки queries. Запросы идут блоками по
+    // kQueryBatch: строка набора, загруженная в кэш, проверяется сразу для
+    // всего блока. Блоки распределяются между потоками.
+    std::vector<std::vector<Neighbor>> nearest(const ArrayBatch& queries, size_t k, 
+                                               ThreadPool* pool = nullptr) const {
+        checkDimension(queries.dimension);
+        k = std::min(k, getSize());
+        std::vector<std::vector<Neighbor>> result(queries.getSize());
+        parallelFor(queries.getSize(), [&](size_t begin, size_t end) {
+            for (size_t j = 0; j < getSize(); j++) {
+                for (size_t i = begin; i < end; i++) {
+                    offerCandidate(queries.row(i), j, k, result[i]);
+                }
+            }
+            for (size_t i = begin; i < end; i++) {
+                std::sort_heap(result[i].begin(), result[i].end());
+            }
+        }, kQueryBatch, pool);
+        return result;
+    }
+    
+private:
+    static constexpr size_t kRowBlock = 1024;
+    static constexpr size_t kQueryBatch = 8;
+    static constexpr size_t kPruneChunk = 32;
+    // Запас на погрешность округления частичных сумм: отброшенный кандидат
+    // гарантированно дальше k-го
+    static constexpr double kPruneSlack = 1e-3;
+    
+    // Размерность набора по первому массиву; пустой список - ошибка
+    // вызова, а не нулевой размер массива
+    static size_t dimensionOf(const std::vector<Array<T>>& arrays) {
+        if (arrays.empty()) {
+            throw std::invalid_argument("Список массивов для набора пуст");
+        }
+        return arrays[0].getSize();
+    }
+    
+    // Предлагает строку j в max-кучу heap из не более чем k лучших
+    void offerCandidate(const T* q, size_t j, size_t k, std::vector<Neighbor>& heap) const {
+        const T* x = row(j);
+        double sums[3];
+        if (heap.size() == k) {
+            if (k == 0) {
+                return;
+            }
+            double worst = heap.front().distance;
+            double bound = worst * worst * (1.0 + kPruneSlack);
+            double partialSum = 0.0;
+            for (size_t begin = 0; begin < dimension; begin += kPruneChunk) {
+                size_t len = std::min(kPruneChunk, dimension - begin);
+                metricSums<T, Metric::SquaredL2>(q + begin, x + begin, len, sums);
+                partialSum += sums[0];
+                if (partialSum > bound) {
+                    INSTR_COUNT("pz9.knn_pruned");
+                    return;
+                }
+            }
+        }
+        
+        // Точное расстояние тем же способом, что и euclideanDistance
+        metricSums<T, Metric::SquaredL2>(q, x, dimension, sums);
+        Neighbor candidate{j, std::sqrt(sums[0])};
+        if (heap.size() < k) {
+            heap.push_back(candidate);
+            std::push_heap(heap.begin(), heap.end());
+        } else if (candidate < heap.front()) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = candidate;
+            std::push_heap(heap.begin(), heap.end());
+        }
+    }
+    
+    // Строк-запросов в блоке: около 128 КБ (в L2), кратно kDotRows
+    size_t queryBlockRows() const {
+        size_t rows = 131072 / (dimension * sizeof(T));
+        rows = std::max<size_t>(kDotRows, std::min<size_t>(96, rows));
+        return rows / kDotRows * kDotRows;
+    }
+    
+    // Копия набора панелями для panelDots; последняя дополнена нулями
+    std::vector<T> packPanels() const {
+        size_t panelCount = (getSize() + kPanelCols - 1) / kPanelCols;
+        std::vector<T> panels(panelCount * kPanelCols * dimension, T());
+        for (size_t j = 0; j < getSize(); j++) {
+            T* panel = panels.data() + j / kPanelCols * kPanelCols * dimension;
+            for (size_t k = 0; k < dimension; k++) {
+                panel[k * kPanelCols + j % kPanelCols] = row(j)[k];
+            }
+        }
+        return panels;
+    }
+    
+    void checkDimension(size_t other) const {
+        if (other != dimension) {
+            throw std::invalid_argument("Массивы должны иметь одинаковый размер: " + 
+                                       std::to_string(other) + " != " + 
+                                       std::to_string(dimension));
+        }
+    }
+    
+    size_t dimension;
+    std::vector<T> values;
+    std::vector<double> norms;  // квадраты норм строк
+};
+
+// Приближённый поиск ближайших соседей: граф HNSW (Malkov, Yashunin) над
+// массивами float/double одной длины.
+//
+// Каждая точка получает случайный уровень (вероятность уровня >= l равна
+// m^-l) и связывается с ближайшими соседями на каждом своём уровне. Поиск
+// жадно спускается с верхнего разреженного уровня к нулевому, а там
+// перебирает ef лучших кандидатов. Больше m и efConstruction - точнее граф
+// и дольше построение; больше efSearch - выше полнота и дольше запрос.
+//
+// insert() добавляет точки по одной; build() добавляет пакет, связывая
+// точки в нескольких потоках (соседние списки защищены мьютексами узлов).
+// search() можно вызывать из многих потоков одновременно, но не во время
+// insert()/build(). save()/load() - один двоичный файл в порядке байт
+// машины.
+struct HnswParams {
+    size_t m = 16;                // соседей на уровнях выше нулевого (на нулевом - 2m)
+    size_t efConstruction = 200;  // ширина поиска при вставке
+    size_t efSearch = 64;         // ширина поиска при запросе
+    uint64_t seed = 42;           // уровни точек выводятся из seed и номера
+};
+
+template<typename T>
+class HnswIndex {
+    static_assert(std::is_floating_point<T>::value, "HnswIndex строится для float и double");
+    
+public:
+    explicit HnswIndex(size_t dimension, HnswParams params = HnswParams()) 
+        : dimension(dimension), params(params), entryLock(new std::mutex) {
+        if (dimension == 0) {
+            throw std::invalid_argument("Размер массива должен быть положительным числом");
+        }
+        if (params.m < 2 || params.m > kMaxM) {
+            throw std::invalid_argument("Параметр m должен быть от 2 до " + std::to_string(kMaxM));
+        }
+        levelFactor = 1.0 / std::log(static_cast<double>(params.m));
+    }
+    
+    size_t getSize() const {
+        return nodes.size();
+    }
+    
+    size_t getDimension() const {
+        return dimension;
+    }
+    
+    const HnswParams& getParams() const {
+        return params;
+    }
+    
+    void setEfSearch(size_t ef) {
+        params.efSearch = ef;
+    }
+    
+    // Добавляет точку, возвращает её номер
+    size_t insert(const Array<T>& arr) {
+        size_t id = append(arr);
+        link(static_cast<uint32_t>(id));
+        return id;
+    }
+    
+    // Добавляет все точки; связывание идёт на пуле pool (по умолчанию общем)
+    void build(const std::vector<Array<T>>& arrays, ThreadPool* pool = nullptr) {
+        size_t first = nodes.size();
+        values.reserve(values.size() + arrays.size() * dimension);
+        nodes.reserve(nodes.size() + arrays.size());
+        for (const Array<T>& arr : arrays) {
+            append(arr);
+        }
+        
+        // Первая точка графа задаёт вход, её связываем до запуска потоков
+        if (first == 0 && !nodes.empty()) {
+            link(0);
+            first = 1;
+        }
+        parallelFor(nodes.size() - first, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                link(static_cast<uint32_t>(first + i));
+            }
+        }, kBuildBlock, pool);
+    }
+    
+    // k приближённо ближайших к query точек по возрастанию (расстояние, номер)
+    std::vector<Neighbor> search(const Array<T>& query, size_t k) const {
+        return search(query, k, params.efSearch);
+    }
+    
+    std::vector<Neighbor> search(const Array<T>& query, size_t k, size_t ef) const {
+        if (query.getSize() != dimension) {
+            throw std::invalid_argument("Массивы должны иметь одинаковый размер: " + 
+                                       std::to_string(query.getSize()) + " != " + 
+                                       std::to_string(dimension));
+        }
+        std::vector<Neighbor> result;
+        if (nodes.empty() || k == 0) {
+            return result;
+        }
+        
+        const T* q = &query[0];
+        uint32_t current = entry;
+        double currentDistance = distance(q, current);
+        for (int level = maxLevel; level > 0; level--) {
+            greedyStep(q, current, currentDistance, level);
+        }
+        std::vector<Candidate> found = searchLayer(q, current, currentDistance, std::max(ef, k), 0);
+        
+        std::sort(found.begin(), found.end());
+        found.resize(std::min(k, found.size()));
+        for (const Candidate& c : found) {
+            result.push_back(Neighbor{c.id, std::sqrt(c.distance)});
+        }
+        std::sort(result.begin(), result.end());
+        return result;
     }
     
-    // Конструктор копирования
-    Array(const Array& other) : size(other.size) {
-        data = new T[size];
-        for (size_t i = 0; i < size; i++) {
-            data[i] = other.data[i];
+    void save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("Не удалось открыть файл для записи: " + path);
+        }
+        uint64_t header[] = {
+            sizeof(T), dimension, nodes.size(), params.m, params.efConstruction, 
+            params.efSearch, params.seed, entry, static_cast<uint64_t>(maxLevel + 1)
+        };
+        out.write(kMagic, sizeof(kMagic));
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        for (const auto& node : nodes) {
+            uint32_t levels = static_cast<uint32_t>(node->links.size());
+            out.write(reinterpret_cast<const char*>(&levels), sizeof(levels));
+            for (const std::vector<uint32_t>& links : node->links) {
+                uint32_t count = static_cast<uint32_t>(links.size());
+                out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+                out.write(reinterpret_cast<const char*>(links.data()), count * sizeof(uint32_t));
+            }
+        }
+        if (!out.flush()) {
+            throw std::runtime_error("Ошибка записи индекса: " + path);
         }
     }
     
-    // Оператор присваивания
-    Array& operator=(const Array& other) {
-        if (this != &other) {
-            delete[] data;
-            size = other.size;
-            data = new T[size];
-            for (size_t i = 0; i < size; i++) {
-                data[i] = other.data[i];
+    // Любой повреждённый или чужой файл - std::runtime_error; размеры из
+    // заголовка сверяются с длиной файла до выделения памяти
+    static HnswIndex load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            throw std::runtime_error("Не удалось открыть файл: " + path);
+        }
+        auto bad = [&path]() {
+            return std::runtime_error("Неверный формат файла индекса: " + path);
+        };
+        uint64_t fileBytes = static_cast<uint64_t>(in.tellg());
+        in.seekg(0);
+        char magic[sizeof(kMagic)];
+        uint64_t header[9];
+        in.read(magic, sizeof(magic));
+        in.read(reinterpret_cast<char*>(header), sizeof(header));
+        if (!in || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || header[0] != sizeof(T) || 
+            header[1] == 0 || header[2] > std::numeric_limits<uint32_t>::max()) {
+            throw bad();
+        }
+        
+        // Байт после заголовка; каждое чтение ниже сначала вычитается отсюда
+        uint64_t remaining = fileBytes - sizeof(kMagic) - sizeof(header);
+        auto take = [&remaining](uint64_t count, uint64_t itemBytes) {
+            if (count > remaining / itemBytes) {
+                return false;
+            }
+            remaining -= count * itemBytes;
+            return true;
+        };
+        
+        HnswParams params;
+        params.m = header[3];
+        params.efConstruction = header[4];
+        params.efSearch = header[5];
+        params.seed = header[6];
+        size_t count = header[2];
+        // Точки (dimension значений), а за ними у каждого узла не меньше
+        // числа уровней и одного числа связей
+        if (header[1] > remaining / sizeof(T) || !take(count, header[1] * sizeof(T)) || 
+            count > remaining / (2 * sizeof(uint32_t))) {
+            throw bad();
+        }
+        HnswIndex index = [&]() {
+            try {
+                return HnswIndex(header[1], params);
+            } catch (const std::invalid_argument&) {
+                throw bad();
+            }
+        }();
+        index.entry = static_cast<uint32_t>(header[7]);
+        index.maxLevel = header[8] <= kMaxLevels ? static_cast<int>(header[8]) - 1 : -2;
+        
+        index.values.resize(count * index.dimension);
+        in.read(reinterpret_cast<char*>(index.values.data()), index.values.size() * sizeof(T));
+        for (size_t i = 0; i < count && in; i++) {
+            uint32_t levels = 0;
+            in.read(reinterpret_cast<char*>(&levels), sizeof(levels));
+            if (!take(1, sizeof(levels)) || levels == 0 || levels > kMaxLevels) {
+                in.setstate(std::ios::failbit);
+                break;
             }
+            std::unique_ptr<Node> node(new Node);
+            node->links.resize(levels);
+            for (std::vector<uint32_t>& links : node->links) {
+                uint32_t linkCount = 0;
+                in.read(reinterpret_cast<char*>(&linkCount), sizeof(linkCount));
+                if (!take(1, sizeof(linkCount)) || linkCount > 2 * params.m || 
+                    !take(linkCount, sizeof(uint32_t))) {
+                    in.setstate(std::ios::failbit);
+                    break;
+                }
+                links.resize(linkCount);
+                in.read(reinterpret_cast<char*>(links.data()), linkCount * sizeof(uint32_t));
+            }
+            index.nodes.push_back(std::move(node));
         }
-        return *this;
+        if (!in || remaining != 0 || index.nodes.size() != count || !index.linksValid()) {
+            throw bad();
+        }
+        return index;
     }
     
-    // Получение размера
-    size_t getSize() const {
-        return size;
+private:
+    static constexpr char kMagic[8] = {'P', 'Z', '9', 'H', 'N', 'S', 'W', '1'};
+    static constexpr uint32_t kMaxLevels = 32;
+    static constexpr size_t kMaxM = 1 << 16;  // 2m связей узла умещаются в uint32_t
+    static constexpr size_t kBuildBlock = 64;
+    
+    struct Node {
+        std::vector<std::vector<uint32_t>> links;  // соседи на уровнях 0..level
+        std::mutex lock;
+    };
+    
+    // Кандидат поиска: квадрат расстояния до запроса и номер точки
+    struct Candidate {
+        double distance;
+        uint32_t id;
+        
+        bool operator<(const Candidate& other) const {
+            return distance < other.distance || 
+                   (distance == other.distance && id < other.id);
+        }
+        
+        bool operator>(const Candidate& other) const {
+            return other < *this;
+        }
+    };
+    
+    const T* point(uint32_t id) const {
+        return values.data() + static_cast<size_t>(id) * dimension;
     }
     
-    // Оператор [] для доступа к элементам (без проверки границ для производительности)
-    T& operator[](size_t index) {
-        return data[index];
+    double distance(const T* q, uint32_t id) const {
+        double sums[3];
+        metricSums<T, Metric::SquaredL2>(q, point(id), dimension, sums);
+        return sums[0];
     }
     
-    const T& operator[](size_t index) const {
-        return data[index];
+    size_t maxLinks(int level) const {
+        return level == 0 ? 2 * params.m : params.m;
     }
     
-    // Безопасный доступ с проверкой границ
-    T& at(size_t index) {
-        if (index >= size) {
-            throw std::out_of_range("Индекс " + std::to_string(index) + 
-                                   " выходит за границы массива [0, " + 
-                                   std::to_string(size - 1) + "]");
+    // Уровень точки: -ln(u) / ln(m), где u - псевдослучайное из (seed, номер);
+    // так уровни не зависят от порядка вставки потоками
+    int levelOf(uint64_t id) const {
+        uint64_t z = params.seed + (id + 1) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        double u = (static_cast<double>(z >> 11) + 1.0) / 9007199254740992.0;
+        int level = static_cast<int>(-std::log(u) * levelFactor);
+        return std::min(level, static_cast<int>(kMaxLevels) - 1);
+    }
+    
+    size_t append(const Array<T>& arr) {
+        if (arr.getSize() != dimension) {
+            throw std::invalid_argument("Массивы должны иметь одинаковый размер: " + 
+                                       std::to_string(arr.getSize()) + " != " + 
+                                       std::to_string(dimension));
         }
-        return data[index];
+        if (nodes.size() >= std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("Слишком много точек в индексе");
+        }
+        for (size_t i = 0; i < dimension; i++) {
+            values.push_back(arr[i]);
+        }
+        std::unique_ptr<Node> node(new Node);
+        node->links.resize(levelOf(nodes.size()) + 1);
+        nodes.push_back(std::move(node));
+        return nodes.size() - 1;
     }
     
-    const T& at(size_t index) const {
-        if (index >= size) {
-            throw std::out_of_range("Индекс " + std::to_string(index) + 
-                                   " выходит за границы массива [0, " + 
-                                   std::to_string(size - 1) + "]");
+    // visit(сосед) для каждого соседа id на уровне level, под мьютексом узла
+    template<typename Visitor>
+    void forEachLink(uint32_t id, int level, Visitor visit) const {
+        Node& node = *nodes[id];
+        std::lock_guard<std::mutex> guard(node.lock);
+        for (uint32_t next : node.links[level]) {
+            visit(next);
         }
-        return data[index];
     }
     
-    // Сеттер с проверкой для числовых типов (специализация через SFINAE)
-    template<typename U = T>
-    typename std::enable_if<std::is_arithmetic<U>::value>::type
-    setWithCheck(size_t index, U value) {
-        // Для числовых типов можно добавить дополнительную проверку
-        // Например, проверку диапазона для целых чисел
-        if (index >= size) {
-            throw std::out_of_range("Индекс " + std::to_string(index) + 
-                                   " выходит за границы массива");
+    // Переход к ближайшему соседу, пока расстояние уменьшается
+    void greedyStep(const T* q, uint32_t& current, double& currentDistance, int level) const {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            uint32_t from = current;
+            forEachLink(from, level, [&](uint32_t next) {
+                double d = distance(q, next);
+                if (d < currentDistance) {
+                    currentDistance = d;
+                    current = next;
+                    changed = true;
+                }
+            });
         }
-        data[index] = value;
     }
     
-    // Перегрузка для нечисловых типов (просто сеттер без дополнительной проверки)
-    template<typename U = T>
-    typename std::enable_if<!std::is_arithmetic<U>::value>::type
-    setWithCheck(size_t index, const U& value) {
-        if (index >= size) {
-            throw std::out_of_range("Индекс " + std::to_string(index) + 
-                                   " выходит за границы массива");
+    // ef ближайших к q точек уровня level, найденных от start (без порядка)
+    std::vector<Candidate> searchLayer(const T* q, uint32_t start, double startDistance, 
+                                       size_t ef, int level) const {
+        // Метки посещения: номер поиска на поток, массив не очищается
+        thread_local std::vector<uint32_t> visited;
+        thread_local uint32_t epoch = 0;
+        if (visited.size() < nodes.size()) {
+            visited.resize(nodes.size(), 0);
         }
-        data[index] = value;
+        if (++epoch == 0) {
+            std::fill(visited.begin(), visited.end(), 0);
+            epoch = 1;
+        }
+        
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> frontier;
+        std::priority_queue<Candidate> best;
+        frontier.push(Candidate{startDistance, start});
+        best.push(Candidate{startDistance, start});
+        visited[start] = epoch;
+        
+        while (!frontier.empty()) {
+            Candidate c = frontier.top();
+            if (c.distance > best.top().distance && best.size() >= ef) {
+                break;
+            }
+            frontier.pop();
+            forEachLink(c.id, level, [&](uint32_t next) {
+                if (visited[next] == epoch) {
+                    return;
+                }
+                visited[next] = epoch;
+                double d = distance(q, next);
+                if (best.size() < ef || d < best.top().distance) {
+                    frontier.push(Candidate{d, next});
+                    best.push(Candidate{d, next});
+                    if (best.size() > ef) {
+                        best.pop();
+                    }
+                }
+            });
+        }
+        
+        std::vector<Candidate> result;
+        result.reserve(best.size());
+        while (!best.empty()) {
+            result.push_back(best.top());
+            best.pop();
+        }
+        return result;
     }
     
-    // Операция вывода
-    friend std::ostream& operator<<(std::ostream& os, const Array<T>& arr) {
-        os << "[";
-        for (size_t i = 0; i < arr.size; i++) {
-            os << arr.data[i];
-            if (i < arr.size - 1) {
-                os << ", ";
+    // Эвристика выбора соседей: кандидат (по возрастанию расстояния)
+    // берётся, только если он ближе к точке, чем к любому уже выбранному
+    // соседу, - так связи расходятся в разные стороны
+    std::vector<uint32_t> selectNeighbors(std::vector<Candidate>& candidates, size_t limit) const {
+        std::sort(candidates.begin(), candidates.end());
+        std::vector<uint32_t> selected;
+        for (const Candidate& c : candidates) {
+            if (selected.size() >= limit) {
+                break;
+            }
+            bool diverse = true;
+            for (uint32_t s : selected) {
+                if (distance(point(c.id), s) < c.distance) {
+                    diverse = false;
+                    break;
+                }
+            }
+            if (diverse) {
+                selected.push_back(c.id);
             }
         }
-        os << "]";
-        return os;
+        return selected;
     }
     
-    // Вычисление евклидова расстояния между массивами
-    template<typename U = T>
-    typename std::enable_if<std::is_arithmetic<U>::value, double>::type
-    static euclideanDistance(const Array<U>& arr1, const Array<U>& arr2) {
-        if (arr1.size != arr2.size) {
-            throw std::invalid_argument("Массивы должны иметь одинаковый размер: " + 
-                                       std::to_string(arr1.size) + " != " + 
-                                       std::to_string(arr2.size));
+    // Связывает уже добавленную точку id с графом
+    void link(uint32_t id) {
+        const T* q = point(id);
+        int level = static_cast<int>(nodes[id]->links.size()) - 1;
+        
+        // Точка выше текущего верха становится новым входом; до этого
+        // остальные потоки вставляют через старый вход
+        std::unique_lock<std::mutex> top(*entryLock);
+        if (maxLevel < 0) {
+            entry = id;
+            maxLevel = level;
+            return;
+        }
+        uint32_t current = entry;
+        int topLevel = maxLevel;
+        if (level <= topLevel) {
+            top.unlock();
+        }
+        double currentDistance = distance(q, current);
+        for (int l = topLevel; l > level; l--) {
+            greedyStep(q, current, currentDistance, l);
         }
         
-        double sum = 0.0;
-        for (size_t i = 0; i < arr1.size; i++) {
-            double diff = static_cast<double>(arr1.data[i]) - static_cast<double>(arr2.data[i]);
-            sum += diff * diff;
+        for (int l = std::min(level, topLevel); l >= 0; l--) {
+            std::vector<Candidate> found = searchLayer(q, current, currentDistance, params.efConstruction, l);
+            std::vector<uint32_t> selected = selectNeighbors(found, params.m);
+            setLinks(id, selected, l);
+            for (uint32_t other : selected) {
+                addLink(other, id, l);
+            }
+            // Следующий уровень начинаем с ближайшей найденной точки
+            current = found.front().id;
+            currentDistance = found.front().distance;
         }
         
-        return std::sqrt(sum);
+        if (top.owns_lock()) {
+            entry = id;
+            maxLevel = level;
+        }
     }
     
-    // Перегрузка для нечисловых типов
-    template<typename U = T>
-    typename std::enable_if<!std::is_arithmetic<U>::value, double>::type
-    static euclideanDistance(const Array<U>& arr1, const Array<U>& arr2) {
-        // Для нечисловых типов выбрасываем исключение
-        throw std::bad_typeid();
+    // Собственные связи точки id на уровне level. Другие потоки могли уже
+    // добавить к ней обратные связи - они сохраняются
+    void setLinks(uint32_t id, const std::vector<uint32_t>& selected, int level) {
+        Node& node = *nodes[id];
+        std::lock_guard<std::mutex> guard(node.lock);
+        std::vector<uint32_t>& links = node.links[level];
+        if (links.empty()) {
+            links = selected;
+            return;
+        }
+        std::vector<Candidate> candidates;
+        for (uint32_t l : selected) {
+            candidates.push_back(Candidate{distance(point(id), l), l});
+        }
+        for (uint32_t l : links) {
+            if (std::find(selected.begin(), selected.end(), l) == selected.end()) {
+                candidates.push_back(Candidate{distance(point(id), l), l});
+            }
+        }
+        if (candidates.size() <= maxLinks(level)) {
+            links.clear();
+            for (const Candidate& c : candidates) {
+                links.push_back(c.id);
+            }
+        } else {
+            links = selectNeighbors(candidates, maxLinks(level));
+        }
+    }
+    
+    // Обратная связь other -> id; при переполнении список other
+    // прореживается той же эвристикой
+    void addLink(uint32_t other, uint32_t id, int level) {
+        Node& node = *nodes[other];
+        std::lock_guard<std::mutex> guard(node.lock);
+        std::vector<uint32_t>& links = node.links[level];
+        if (links.size() < maxLinks(level)) {
+            links.push_back(id);
+            return;
+        }
+        const T* base = point(other);
+        std::vector<Candidate> candidates;
+        candidates.push_back(Candidate{distance(base, id), id});
+        for (uint32_t l : links) {
+            candidates.push_back(Candidate{distance(base, l), l});
+        }
+        links = selectNeighbors(candidates, maxLinks(level));
+    }
+    
+    // Проверка ссылок после загрузки: номера и уровни в пределах графа
+    bool linksValid() const {
+        if (nodes.empty()) {
+            return maxLevel == -1;
+        }
+        if (entry >= nodes.size() || maxLevel + 1 != static_cast<int>(nodes[entry]->links.size())) {
+            return false;
+        }
+        for (const auto& node : nodes) {
+            for (size_t l = 0; l < node->links.size(); l++) {
+                for (uint32_t id : node->links[l]) {
+                    if (id >= nodes.size() || nodes[id]->links.size() <= l) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
     }
+    
+    size_t dimension;
+    HnswParams params;
+    double levelFactor;
+    std::vector<T> values;
+    std::vector<std::unique_ptr<Node>> nodes;
+    uint32_t entry = 0;
+    int maxLevel = -1;
+    std::unique_ptr<std::mutex> entryLock;  // вход графа и верхний уровень
 };
 
-// Специальный сеттер с проверкой диапазона для числовых значений
-template<typename T>
-class ArrayRangeChecker {
-public:
-    // Проверка и установка значения с проверкой диапазона
-    template<typename U = T>
-    static typename std::enable_if<std::is_arithmetic<U>::value>::type
-    setWithRangeCheck(Array<U>& arr, size_t index, U value, U minVal, U maxVal) {
-        if (value < minVal || value > maxVal) {
-            throw std::invalid_argument("Значение " + std::to_string(value) + 
-                                       " должно быть в диапазоне [" + 
-                                       std::to_string(minVal) + ", " + 
-                                       std::to_string(maxVal) + "]");
+// Замер HnswIndex: полнота@10 и запросов в секунду при разных efSearch,
+// эталон - точный поиск ArrayBatch::nearest. Точки - смесь гауссовых
+// облаков (как у реальных эмбеддингов), размерность 64.
+void runAnnBenchmark(size_t n) {
+    const size_t kDimension = 64;
+    const size_t kQueries = 1000;
+    const size_t kClusters = 100;
+    const size_t k = 10;
+    
+    std::mt19937 rng(1);
+    std::normal_distribution<float> normal;
+    std::vector<Array<float>> centers;
+    for (size_t c = 0; c < kClusters; c++) {
+        Array<float> center(kDimension);
+        for (size_t i = 0; i < kDimension; i++) {
+            center[i] = normal(rng) * 4.0f;
         }
-        arr.setWithCheck(index, value);
+        centers.push_back(center);
     }
+    auto sample = [&]() {
+        Array<float> point = centers[rng() % kClusters];
+        for (size_t i = 0; i < kDimension; i++) {
+            point[i] += normal(rng);
+        }
+        return point;
+    };
     
-    // Для нечисловых типов - просто установка (без проверки диапазона)
-    template<typename U = T>
-    static typename std::enable_if<!std::is_arithmetic<U>::value>::type
-    setWithRangeCheck(Array<U>& arr, size_t index, const U& value, U minVal, U maxVal) {
-        // Для нечисловых типов игнорируем minVal и maxVal
-        arr.setWithCheck(index, value);
+    std::vector<Array<float>> points;
+    for (size_t i = 0; i < n; i++) {
+        points.push_back(sample());
     }
-};
+    ArrayBatch<float> queries(kDimension);
+    std::vector<Array<float>> queryPoints;
+    for (size_t i = 0; i < kQueries; i++) {
+        queryPoints.push_back(sample());
+        queries.add(queryPoints.back());
+    }
+    
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    };
+    
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<Neighbor>> exact = ArrayBatch<float>(points).nearest(queries, k);
+    std::cout << "Точек: " << n << ", размерность " << kDimension 
+              << ", запросов " << kQueries << std::endl;
+    std::cout << "Точный поиск: " << seconds(start) << " с на все запросы" << std::endl;
+    
+    HnswIndex<float> index(kDimension);
+    start = std::chrono::steady_clock::now();
+    index.build(points);
+    std::cout << "Построение HNSW: " << seconds(start) << " с" << std::endl;
+    
+    const std::string path = "hnsw_bench.idx";
+    start = std::chrono::steady_clock::now();
+    index.save(path);
+    HnswIndex<float> loaded = HnswIndex<float>::load(path);
+    std::remove(path.c_str());
+    std::cout << "Сохранение и загрузка: " << seconds(start) << " с" << std::endl;
+    
+    for (size_t ef : {10, 20, 40, 80, 160, 320}) {
+        size_t hits = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t q = 0; q < kQueries; q++) {
+            std::vector<Neighbor> found = loaded.search(queryPoints[q], k, ef);
+            for (const Neighbor& f : found) {
+                for (const Neighbor& e : exact[q]) {
+                    if (f.index == e.index) {
+                        hits++;
+                        break;
+                    }
+                }
+            }
+        }
+        double elapsed = seconds(start);
+        std::cout << "efSearch " << ef << ": полнота@10 " << static_cast<double>(hits) / (kQueries * k)
+                  << ", " << kQueries / elapsed << " запросов/с, " 
+                  << elapsed / kQueries * 1e6 << " мкс на запрос" << std::endl;
+    }
+}
+
+// Замер массовых операций Array на общем пуле против последовательных
+// std::sort / цикла на тех же данных
+void runParallelBenchmark(size_t n) {
+    std::mt19937 rng(1);
+    Array<int32_t> keys(n);
+    Array<double> values(n);
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = static_cast<int32_t>(rng());
+        values[i] = static_cast<double>(rng()) / rng.max();
+    }
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::cout << "Элементов: " << n << ", потоков в пуле: " << ThreadPool::shared().getThreads() << std::endl;
+    
+    std::vector<int32_t> plain(&keys[0], &keys[0] + n);
+    auto start = std::chrono::steady_clock::now();
+    std::sort(plain.begin(), plain.end());
+    double serialSort = seconds(start);
+    start = std::chrono::steady_clock::now();
+    keys.sort();
+    double parallelSortTime = seconds(start);
+    std::cout << "Сортировка int32: std::sort " << serialSort * 1000 << " мс, Array::sort "
+              << parallelSortTime * 1000 << " мс" << std::endl;
+    if (!std::equal(plain.begin(), plain.end(), &keys[0])) {
+        std::cout << "Результаты сортировки не совпадают!" << std::endl;
+    }
+    
+    start = std::chrono::steady_clock::now();
+    double serialSum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        serialSum += values[i];
+    }
+    double serialTime = seconds(start);
+    start = std::chrono::steady_clock::now();
+    double total = values.reduce(0.0, std::plus<double>());
+    double parallelTime = seconds(start);
+    std::cout << "Сумма double: цикл " << serialTime * 1000 << " мс, Array::reduce "
+              << parallelTime * 1000 << " мс (разница " << std::abs(total - serialSum) << ")" << std::endl;
+}
+
+// Резидентная память процесса в МиБ (Linux, /proc); -1, если неизвестно
+double residentMiB() {
+    std::ifstream statm("/proc/self/statm");
+    long total = 0, resident = -1;
+    if (!(statm >> total >> resident)) {
+        return -1.0;
+    }
+    return resident * 4096.0 / (1 << 20);
+}
+
+// Замер MappedArray на файлах больше оперативной памяти: два массива по n
+// float заполняются окнами, затем открываются заново и сравниваются.
+// Открытие не читает элементы, а проходы выгружают прочитанное, поэтому
+// время открытия и резидентная память не зависят от n
+void runMappedBenchmark(size_t n) {
+    const std::string pathA = "mmap_bench_a.bin";
+    const std::string pathB = "mmap_bench_b.bin";
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    const size_t window = size_t(1) << 22;
+    auto start = std::chrono::steady_clock::now();
+    {
+        MappedArray<float> a = MappedArray<float>::create(pathA, n);
+        MappedArray<float> b = MappedArray<float>::create(pathB, n);
+        a.advise(MapAdvice::Sequential);
+        b.advise(MapAdvice::Sequential);
+        for (size_t first = 0; first < n; first += window) {
+            size_t last = std::min(n, first + window);
+            for (size_t i = first; i < last; i++) {
+                a[i] = static_cast<float>(i % 7);
+                b[i] = static_cast<float>(i % 7) + 1.0f;
+            }
+            a.evict(first, last);
+            b.evict(first, last);
+        }
+        a.flush();
+        b.flush();
+    }
+    double gib = 2.0 * n * sizeof(float) / (size_t(1) << 30);
+    std::cout << "Элементов: " << n << " x 2 (" << gib << " ГиБ), запись " << seconds(start) 
+              << " с, резидентно " << residentMiB() << " МиБ" << std::endl;
+    
+    start = std::chrono::steady_clock::now();
+    MappedArray<float> a = MappedArray<float>::open(pathA, MapMode::ReadOnly, MapAdvice::Sequential);
+    MappedArray<float> b = MappedArray<float>::open(pathB, MapMode::ReadOnly, MapAdvice::Sequential);
+    std::cout << "Открытие: " << seconds(start) * 1000 << " мс, резидентно " 
+              << residentMiB() << " МиБ" << std::endl;
+    
+    start = std::chrono::steady_clock::now();
+    double distance = MappedArray<float>::euclideanDistance(a, b);
+    double elapsed = seconds(start);
+    std::cout << "Евклидово расстояние " << distance << " (ожидалось " << std::sqrt(static_cast<double>(n)) 
+              << "): " << elapsed << " с, " << gib / elapsed << " ГиБ/с, резидентно " 
+              << residentMiB() << " МиБ" << std::endl;
+    std::remove(pathA.c_str());
+    std::remove(pathB.c_str());
+}
 
 // Пример использования
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench-ann") {
+        try {
+            runAnnBenchmark(argc > 2 ? std::stoul(argv[2]) : 100000);
+        }
+        catch (const std::exception& e) {
+            std::cout << "Ошибка замера: " << e.what() << std::endl;
+        }
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-parallel") {
+        try {
+            runParallelBenchmark(argc > 2 ? std::stoul(argv[2]) : 20000000);
+        }
+        catch (const std::exception& e) {
+            std::cout << "Ошибка замера: " << e.what() << std::endl;
+        }
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-mmap") {
+        try {
+            runMappedBenchmark(argc > 2 ? std::stoul(argv[2]) : size_t(1) << 30);
+        }
+        catch (const std::exception& e) {
+            std::cout << "Ошибка замера: " << e.what() << std::endl;
+        }
+        return 0;
+    }
+    
     std::cout << "Тестирование массива с int" << std::endl;
     try {
         Array<int> intArr(5);
@@ -257,6 +2989,46 @@ int main() {
             std::cout << "Поймано std::bad_typeid: невозможно вычислить расстояние для нечисловых типов" << std::endl;
         }
         
+        // Строки лежат в одной арене; с интернированием повторы хранятся один раз
+        Array<std::string> tags(1000);
+        tags.setInterning(true);
+        for (size_t i = 0; i < tags.getSize(); i++) {
+            tags[i] = (i % 3 == 0) ? "red" : (i % 3 == 1) ? "green" : "blue";
+        }
+        std::cout << "tags[0..2]: " << tags[0] << ", " << tags[1] << ", " << tags[2]
+                  << "; арена: " << tags.getArenaSize() << " байт на " << tags.getSize() << " строк" << std::endl;
+        
+        Array<std::string> tagsCopy = tags;
+        tagsCopy[0] = tagsCopy[1];
+        std::cout << "После tagsCopy[0] = tagsCopy[1]: " << tagsCopy.at(0) << ", tags[0] = " << tags.at(0) << std::endl;
+        
+        // Сверка с std::vector<std::string> на случайных записях при
+        // включении и выключении интернирования
+        std::mt19937 rng(7);
+        const char* words[] = {"", "yo", "hello", "red", "green", "a much longer string"};
+        Array<std::string> checked(16);
+        std::vector<std::string> model(16);
+        bool matches = true;
+        for (int step = 0; step < 20000 && matches; step++) {
+            size_t index = rng() % model.size();
+            if (step % 1000 == 999) {
+                checked.setInterning(!checked.isInterning());
+            } else if (rng() % 4 == 0) {
+                size_t from = rng() % model.size();
+                checked[index] = checked[from];
+                model[index] = model[from];
+            } else {
+                const char* word = words[rng() % (sizeof(words) / sizeof(words[0]))];
+                checked[index] = word;
+                model[index] = word;
+            }
+            for (size_t i = 0; i < model.size(); i++) {
+                matches = matches && std::as_const(checked)[i] == model[i];
+            }
+        }
+        std::cout << "Сверка с std::vector<std::string>: " << (matches ? "совпадает" : "РАСХОЖДЕНИЕ")
+                  << ", арена " << checked.getArenaSize() << " байт" << std::endl;
+        
     } catch (const std::exception& e) {
         std::cout << "Ошибка: " << e.what() << std::endl;
     }
@@ -302,10 +3074,202 @@ int main() {
         
         double distance = Array<float>::euclideanDistance(floatArr, floatArr2);
         std::cout << "Евклидово расстояние для float: " << distance << std::endl;
+        std::cout << "L1 для float: " << Array<float>::l1Distance(floatArr, floatArr2) << std::endl;
+        std::cout << "Скалярное произведение для float: " 
+                  << Array<float>::dotProduct(floatArr, floatArr2) << std::endl;
+        std::cout << "Косинусное расстояние для float: " 
+                  << Array<float>::cosineDistance(floatArr, floatArr2) << std::endl;
         
     } catch (const std::exception& e) {
         std::cout << "Ошибка: " << e.what() << std::endl;
     }
     
+    std::cout << "\nТестирование Array с аллокаторами" << std::endl;
+    try {
+        Array<double> aligned(8);
+        std::cout << "Выравнивание данных на 64 байта: " 
+                  << (reinterpret_cast<uintptr_t>(&aligned[0]) % 64 == 0 ? "да" : "нет") << std::endl;
+        
+        // Массивы в общей арене: память возвращается разом вместе с ареной
+        std::pmr::monotonic_buffer_resource arena;
+        using ArenaArray = Array<double, std::pmr::polymorphic_allocator<double>>;
+        ArenaArray first(4, &arena);
+        ArenaArray second(4, &arena);
+        first[0] = 3.0;
+        second[1] = 4.0;
+        std::cout << "Расстояние между массивами из арены: " 
+                  << ArenaArray::euclideanDistance(first, second) << std::endl;
+        
+        ArenaArray moved(std::move(first));
+        std::cout << "После перемещения: " << moved << ", исходный размер " 
+                  << first.getSize() << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << std::endl;
+    }
+    
+    std::cout << "\nТестирование выражений над Array" << std::endl;
+    try {
+        Array<double> a(3), b(3), c(3);
+        for (size_t i = 0; i < 3; i++) {
+            a.setWithCheck(i, i + 1.0);
+            b.setWithCheck(i, 2.0);
+            c.setWithCheck(i, i * 0.5);
+        }
+        
+        // Одно выражение - один проход, без промежуточных массивов
+        Array<double> d = a - b * c;
+        std::cout << "a - b * c = " << d << std::endl;
+        std::cout << "norm(a - b * c) = " << norm(a - b * c) << std::endl;
+        std::cout << "sum(abs(c - a) / 2) = " << sum(abs(c - a) / 2.0) << std::endl;
+        
+        d = d * 2.0 + a;
+        std::cout << "d * 2 + a = " << d << std::endl;
+        
+        Array<double> shorter(2);
+        d = a + shorter;
+    } catch (const std::invalid_argument& e) {
+        std::cout << "Поймано std::invalid_argument: " << e.what() << std::endl;
+    }
+    
+    std::cout << "\nТестирование массовых операций Array" << std::endl;
+    try {
+        Array<int> values(8);
+        int init[] = {5, -3, 12, 7, -3, 0, 9, 1};
+        for (size_t i = 0; i < values.getSize(); i++) {
+            values[i] = init[i];
+        }
+        std::cout << "min = " << values.min() << ", max = " << values.max()
+                  << ", сумма = " << values.reduce(0L, std::plus<long>())
+                  << ", отрицательных = " << values.countIf([](int v) { return v < 0; })
+                  << ", первый > 6 на позиции " << values.find([](int v) { return v > 6; }) << std::endl;
+        values.transform([](int v) { return v * 2; });
+        values.sort();
+        std::cout << "Удвоенный и отсортированный: " << values << std::endl;
+        std::cout << "Замер на больших массивах: pz9 --bench-parallel [число элементов]" << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << std::endl;
+    }
+    
+    std::cout << "\nТестирование MappedArray" << std::endl;
+    try {
+        Array<double> source(5);
+        for (size_t i = 0; i < source.getSize(); i++) {
+            source[i] = i * 1.5;
+        }
+        source.save("mapped_demo.bin");
+        MappedArray<double> mapped = MappedArray<double>::open("mapped_demo.bin");
+        std::cout << "Отображено " << mapped.getSize() << " элементов, mapped[4] = " << mapped.at(4) << std::endl;
+        
+        MappedArray<double> shifted = MappedArray<double>::create("mapped_shifted.bin", 5);
+        for (size_t i = 0; i < shifted.getSize(); i++) {
+            shifted[i] = mapped[i] + 3.0;
+        }
+        shifted.flush();
+        std::cout << "Расстояние между файлами: " << MappedArray<double>::euclideanDistance(mapped, shifted) << std::endl;
+        Array<double> scaled = shifted * 2.0;
+        std::cout << "Удвоенный из файла: " << scaled << std::endl;
+        
+        try {
+            mapped[0] = 1.0;
+        } catch (const std::logic_error& e) {
+            std::cout << "Поймано std::logic_error: " << e.what() << std::endl;
+        }
+        std::cout << "Замер на файлах больше памяти: pz9 --bench-mmap [число элементов]" << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << std::endl;
+    }
+    std::remove("mapped_demo.bin");
+    std::remove("mapped_shifted.bin");
+    
+    std::cout << "\nТестирование ArrayBatch" << std::endl;
+    try {
+        std::vector<Array<double>> points;
+        for (int i = 0; i < 4; i++) {
+            Array<double> point(2);
+            point.setWithCheck(0, i * 3.0);
+            point.setWithCheck(1, i * 4.0);
+            points.push_back(point);
+        }
+        ArrayBatch<double> batch(points);
+        
+        std::vector<double> fromFirst = batch.distancesTo(points[0]);
+        std::cout << "Расстояния от первой точки:";
+        for (double d : fromFirst) {
+            std::cout << " " << d;
+        }
+        std::cout << std::endl;
+        
+        std::vector<double> matrix = batch.pairwiseDistances();
+        std::cout << "Матрица расстояний:" << std::endl;
+        for (size_t i = 0; i < batch.getSize(); i++) {
+            for (size_t j = 0; j < batch.getSize(); j++) {
+                std::cout << " " << matrix[i * batch.getSize() + j];
+            }
+            std::cout << std::endl;
+        }
+        
+        Array<double> target(2);
+        target.setWithCheck(0, 4.0);
+        target.setWithCheck(1, 5.0);
+        std::cout << "Две ближайшие к (4, 5):";
+        for (const Neighbor& n : batch.nearest(target, 2)) {
+            std::cout << " #" << n.index << " (" << n.distance << ")";
+        }
+        std::cout << std::endl;
+        
+        batch.add(Array<double>(3));
+    } catch (const std::invalid_argument& e) {
+        std::cout << "Поймано std::invalid_argument: " << e.what() << std::endl;
+    }
+    
+    std::cout << "\nТестирование HnswIndex" << std::endl;
+    try {
+        HnswIndex<float> index(2);
+        for (int i = 0; i < 100; i++) {
+            Array<float> point(2);
+            point.setWithCheck(0, static_cast<float>(i % 10));
+            point.setWithCheck(1, static_cast<float>(i / 10));
+            index.insert(point);
+        }
+        
+        Array<float> query(2);
+        query.setWithCheck(0, 4.2f);
+        query.setWithCheck(1, 6.9f);
+        std::cout << "Три ближайшие к (4.2, 6.9):";
+        for (const Neighbor& n : index.search(query, 3)) {
+            std::cout << " #" << n.index << " (" << n.distance << ")";
+        }
+        std::cout << std::endl;
+        std::cout << "Замер полноты и скорости: pz9 --bench-ann [число точек]" << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << std::endl;
+    }
+    
+    std::cout << "\nТестирование BoundedArray" << std::endl;
+    try {
+        using Percent = BoundedArray<int, -100, 100>;
+        Percent bounded(4);
+        std::cout << "Байт на элемент: " << sizeof(Percent::Storage) << std::endl;
+        
+        constexpr Percent::Value half(50);  // проверено при компиляции
+        bounded.set(0, half);
+        bounded.set<-100>(1);               // проверено при компиляции
+        bounded.set(2, 75);                 // проверка во время выполнения
+        std::cout << "bounded: " << bounded << std::endl;
+        
+        try {
+            bounded.set(3, 150);
+        } catch (const std::invalid_argument& e) {
+            std::cout << "Ошибка при установке значения 150: " << e.what() << std::endl;
+        }
+        
+    } catch (const std::exception& e) {
+        std::cout << "Ошибка: " << e.what() << std::endl;
+    }
+    
+#ifdef ARRAY_INSTRUMENTATION
+    std::cout << "\n" << Instrumentation::snapshot().toText();
+#endif
+    
     return 0;
 }
\ No newline at end of file